@@ -70,8 +70,9 @@ bool init_opengl_es_everything(Program *program) {
       eglSwapBuffers(gl->display, gl->surface) == EGL_FALSE) {
     return false;
   }
-  init_opengl_es_shaders(&gl->shaders);
-  init_font_atlas_texture(&program->font);
+  init_opengl_es_shaders(&gl->shaders, &program->scratch_arena);
+  init_opengl_es_quad_index_buf(gl);
+  init_font_atlas_texture(&program->fonts);
   return true;
 }
 
@@ -148,6 +149,18 @@ bool show_soft_keyboard(android_app *app, bool show) {
   }
 }
 
+// the on screen text with the status label over its top left corner
+void render_frame(Program *program) {
+  auto *text = &program->on_screen_text;
+  render_on_screen_text(program);
+  char status[64];
+  snprintf(status, sizeof(status), "%u bytes, %d px down", str_len(text->text), (int)text->scroll_y);
+  set_text_label(&program->fonts, &program->status_label, status, text->layout.font, 0, 0x808080ff);
+  draw_text_label(program, use_glyphs_shader(program), &program->status_label, 16, 16);
+  glDisable(GL_BLEND);
+  gl_swap_buffers(&program->opengl_es);
+}
+
 void handle_app_cmd(android_app* app, int32 cmd) {
   Program* program = (Program*)app->userData;
   switch (cmd) {
@@ -185,12 +198,16 @@ void handle_app_cmd(android_app* app, int32 cmd) {
   } break;
   case APP_CMD_LOW_MEMORY: {
     LOGD("received APP_CMD_LOW_MEMORY");
+    #ifdef TRACK_ALLOCATIONS
+    log_alloc_sites();
+    char heap_report_path[256];
+    snprintf(heap_report_path, sizeof(heap_report_path), "%s/heap.folded", app->activity->internalDataPath);
+    write_alloc_sites_folded(heap_report_path);
+    #endif
   } break;
   case APP_CMD_START: {
     program->keyboard_state.shift_on = false;
-    int ascent;
-    stbtt_GetFontVMetrics(&program->font.info, &ascent, nullptr, nullptr);
-    program->on_screen_text.pen_pos_y = ascent * program->font.scale_factor + 250;
+    reset_on_screen_text_layout(program);
     LOGD("received APP_CMD_START");
   } break;
   case APP_CMD_RESUME: {
@@ -203,8 +220,13 @@ void handle_app_cmd(android_app* app, int32 cmd) {
     LOGD("received APP_CMD_PAUSE");
   } break;
   case APP_CMD_STOP: {
+    delete_text_label(&program->status_label);
     delete_str(program->on_screen_text.text);
+    delete_text_layout(&program->on_screen_text.layout);
+    delete_array(program->on_screen_text.gl_instance_chunks);
+    uint32 font = program->on_screen_text.layout.font;
     program->on_screen_text = {};
+    program->on_screen_text.layout.font = font;
     LOGD("received APP_CMD_STOP");
   } break;
   case APP_CMD_DESTROY: {
@@ -235,7 +257,7 @@ char translate_keycode(int android_keycode, bool shift_on) {
     {AKEYCODE_SPACE, ' ', ' '}, {AKEYCODE_GRAVE, '`', '~'}, {AKEYCODE_MINUS, '-', '_'}, {AKEYCODE_EQUALS, '=', '+'},
     {AKEYCODE_LEFT_BRACKET, '[', '{'}, {AKEYCODE_RIGHT_BRACKET, ']', '}'}, {AKEYCODE_BACKSLASH, '\\', '|'},
     {AKEYCODE_SEMICOLON, ';', ':'}, {AKEYCODE_APOSTROPHE, '\'', '\"'},
-    {AKEYCODE_COMMA, ',', '<'}, {AKEYCODE_PERIOD, '.', '>'}, {AKEYCODE_SLASH, '/', '\?'}};
+    {AKEYCODE_COMMA, ',', '<'}, {AKEYCODE_PERIOD, '.', '>'}, {AKEYCODE_SLASH, '/', '\?'}, {AKEYCODE_ENTER, '\n', '\n'}};
   for (int i = 0; i < ARRAY_LEN(alphabet_key_map); ++i) {
     AlphabetKeymap *map = &alphabet_key_map[i];
     if (map->android_key_code == android_keycode) {
@@ -251,6 +273,35 @@ char translate_keycode(int android_keycode, bool shift_on) {
   return 0;
 }
 
+// called on the font load thread, AAssetManager can be used from any thread
+bool map_font_asset(Program::FontLoad *load, const char *path, FileMap *map) {
+  auto *program = (Program *)load->platform_data;
+  return map_asset(map, program->app->activity->assetManager, path);
+}
+
+void write_font_load_pipe(Program::FontLoad *load) {
+  write(load->write_pipe, &load, sizeof(void*));
+}
+
+int font_load_callback(int fd, int event, void* data) {
+  Program *program = (Program*)data;
+  Program::FontLoad *load;
+  int num_bytes = read(fd, &load, sizeof(void*));
+  assert(num_bytes == sizeof(void*));
+  close(load->write_pipe);
+  close(fd);
+  if (!finish_font_load(program)) {
+    LOGW("no font for on screen text");
+  } else if (program->opengl_es.display != EGL_NO_DISPLAY) {
+    if (str_len(program->on_screen_text.text) > 0) {
+      render_frame(program);
+    } else {
+      render_font_atlas(program);
+    }
+  }
+  return 0; // one shot, unregisters fd
+}
+
 int32 handle_app_input(android_app* app, AInputEvent* event) {
   Program* program = (Program*)app->userData;
   if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_KEY) {
@@ -264,24 +315,43 @@ int32 handle_app_input(android_app* app, AInputEvent* event) {
     } else if (action == AKEY_EVENT_ACTION_UP) {
       if (keycode == AKEYCODE_SHIFT_LEFT || keycode == AKEYCODE_SHIFT_RIGHT) {
         program->keyboard_state.shift_on = false;
+      } else if (keycode == AKEYCODE_DEL) {
+        delete_last_char_of_on_screen_text(program);
+        render_frame(program);
       } else {
         char c = translate_keycode(keycode, program->keyboard_state.shift_on);
         if (c) {
-          str_cat(&program->on_screen_text.text, c);
-          add_char_to_on_screen_text_verts_buf(program, c);
-          render_on_screen_text(program);
+          char chars[] = {c, '\0'};
+          add_chars_to_on_screen_text(program, chars);
+          render_frame(program);
         }
       }
     } else if (action == AKEY_EVENT_ACTION_MULTIPLE) {
       LOGD("key multiple %d", keycode);
     }
   } else if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_MOTION) {
-    if (AMotionEvent_getAction(event) == AMOTION_EVENT_ACTION_DOWN) {
-      static bool show = false;
-      show = !show;
-      show_soft_keyboard(app, show);
+    static float last_y = 0;
+    static bool dragged = false; // a drag scrolls the text, a tap toggles the keyboard
+    int action = AMotionEvent_getAction(event) & AMOTION_EVENT_ACTION_MASK;
+    float y = AMotionEvent_getY(event, 0);
+    if (action == AMOTION_EVENT_ACTION_DOWN) {
+      last_y = y;
+      dragged = false;
       return 1;
-    } else if (AMotionEvent_getAction(event) == AMOTION_EVENT_ACTION_UP) {
+    } else if (action == AMOTION_EVENT_ACTION_MOVE) {
+      if (dragged || fabsf(y - last_y) > 16) {
+        dragged = true;
+        scroll_on_screen_text(program, last_y - y);
+        render_frame(program);
+        last_y = y;
+      }
+      return 1;
+    } else if (action == AMOTION_EVENT_ACTION_UP) {
+      if (!dragged) {
+        static bool show = false;
+        show = !show;
+        show_soft_keyboard(app, show);
+      }
       return 1;
     }
   }
@@ -290,28 +360,39 @@ int32 handle_app_input(android_app* app, AInputEvent* event) {
 
 void android_main(android_app* app) {
   app_dummy(); // app crashes without this, wtf?
+  install_pool_allocator();
   Program *program = CALLOC(Program, 1);
   program->app = app;
   program->opengl_es.display = EGL_NO_DISPLAY;
   app->userData = program;
   app->onAppCmd = handle_app_cmd;
   app->onInputEvent = handle_app_input;
-  { // load font
-    AAsset *asset = AAssetManager_open(app->activity->assetManager, "fonts/open-sans/OpenSans-Regular.ttf", AASSET_MODE_STREAMING);
-    if (!asset) {
-      LOGF("font file not found");
-      return;
-    }
-    DEFER(AAsset_close(asset));
-    int buf_len = AAsset_getLength(asset);
-    byte *buf = MALLOC(byte, buf_len);
-    if (AAsset_read(asset, buf, buf_len) != buf_len) {
-      LOGF("cannot read font file");
-      return;
-    }
-    if (!init_font(&program->font, buf)) {
+  if (!init_arena(&program->scratch_arena, 256 * 1024)) {
+    LOGF("cannot allocate scratch arena");
+    return;
+  }
+  init_worker_pool(&program->worker_pool);
+  if (!init_fonts(&program->fonts)) {
+    return;
+  }
+  program->fonts.worker_pool = &program->worker_pool;
+  { // font loads in the background, the first frames go out without text
+    int pipe_fds[2];
+    if (pipe(pipe_fds) == -1) {
+      LOGF("cannot create font load pipe");
       return;
     }
+    ALooper_addFd(app->looper, pipe_fds[0], 0, ALOOPER_EVENT_INPUT, font_load_callback, program);
+    auto *load = &program->font_load;
+    load->ttf_path = "fonts/open-sans/OpenSans-Regular.ttf";
+    load->baked_atlas_path = "fonts/open-sans/OpenSans-Regular.atlas";
+    load->size = 64;
+    load->sdf = program->fonts.sdf;
+    load->map_file = map_font_asset;
+    load->done = write_font_load_pipe;
+    load->write_pipe = pipe_fds[1];
+    load->platform_data = program;
+    start_font_load(load);
   }
   {
     if (pipe(program->network.dns_lookup_pipe) == -1) {
@@ -362,5 +443,8 @@ void android_main(android_app* app) {
       LOGD("time out: %d", fd_type);
     }
   }
+  delete_text_label(&program->status_label);
+  delete_fonts(&program->fonts);
+  delete_worker_pool(&program->worker_pool);
   return;
 }
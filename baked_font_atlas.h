@@ -0,0 +1,108 @@
+/* Copyright (C) 2015-2016 yang chen yngccc@gmail.com
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA. */
+
+// binary layout shared by tools/bake_font_atlas.cpp and the runtime, include after stb_truetype.h.
+// file is a BakedFontAtlasHeader, num_glyphs BakedFontGlyphs, then atlas_w * baked_h alpha pixels.
+// little endian and 4 byte aligned throughout, so it can be used in place straight out of a mapping.
+
+#define BAKED_FONT_ATLAS_MAGIC 0x4b424c59 // "YLBK"
+#define BAKED_FONT_ATLAS_VERSION 1
+#define BAKED_FONT_ATLAS_FIRST_CODEPOINT 32
+#define BAKED_FONT_ATLAS_NUM_CODEPOINTS 95 // printable ascii
+
+struct BakedFontAtlasHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t ttf_hash; // baked_font_atlas_hash of the whole ttf file the glyphs came from
+  float font_size; // pixel height
+  uint32_t oversampling; // horizontal and vertical
+  uint32_t padding;
+  uint32_t atlas_w;
+  uint32_t baked_h; // rows from the top of the atlas the glyphs occupy, padding included
+  uint32_t num_glyphs;
+};
+
+struct BakedFontGlyph {
+  uint32_t codepoint;
+  stbtt_packedchar packed_char; // coordinates in the full atlas
+};
+
+static_assert(sizeof(BakedFontAtlasHeader) == 40, "baked font atlas header layout changed");
+static_assert(sizeof(BakedFontGlyph) == 32, "baked font glyph layout changed");
+
+inline uint64_t baked_font_atlas_hash(const unsigned char *data, size_t len) { // fnv-1a
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < len; ++i) {
+    hash = (hash ^ data[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// packs printable ascii with the stb_truetype packer and returns the whole file as one block from alloc, or null if
+// the glyphs do not fit. alloc/dealloc are passed in so the result can be owned by whichever allocator the caller uses
+inline unsigned char *bake_font_atlas(const unsigned char *ttf, size_t ttf_len, float font_size, uint32_t atlas_size,
+                                      uint32_t padding, uint32_t oversampling,
+                                      void *(*alloc)(size_t size), void (*dealloc)(void *ptr), size_t *baked_len) {
+  unsigned char *pixels = (unsigned char *)alloc(atlas_size * atlas_size);
+  if (!pixels) {
+    return nullptr;
+  }
+  stbtt_pack_context spc;
+  if (!stbtt_PackBegin(&spc, pixels, atlas_size, atlas_size, 0, padding, nullptr)) {
+    dealloc(pixels);
+    return nullptr;
+  }
+  stbtt_PackSetOversampling(&spc, oversampling, oversampling);
+  stbtt_packedchar packed_chars[BAKED_FONT_ATLAS_NUM_CODEPOINTS];
+  int packed = stbtt_PackFontRange(&spc, (unsigned char *)ttf, 0, font_size, BAKED_FONT_ATLAS_FIRST_CODEPOINT,
+                                   BAKED_FONT_ATLAS_NUM_CODEPOINTS, packed_chars);
+  stbtt_PackEnd(&spc);
+  if (!packed) {
+    dealloc(pixels);
+    return nullptr;
+  }
+
+  BakedFontAtlasHeader header = {};
+  header.magic = BAKED_FONT_ATLAS_MAGIC;
+  header.version = BAKED_FONT_ATLAS_VERSION;
+  header.ttf_hash = baked_font_atlas_hash(ttf, ttf_len);
+  header.font_size = font_size;
+  header.oversampling = oversampling;
+  header.padding = padding;
+  header.atlas_w = atlas_size;
+  header.num_glyphs = BAKED_FONT_ATLAS_NUM_CODEPOINTS;
+  for (int i = 0; i < BAKED_FONT_ATLAS_NUM_CODEPOINTS; ++i) {
+    uint32_t bottom = packed_chars[i].y1 + padding;
+    header.baked_h = bottom > header.baked_h ? bottom : header.baked_h;
+  }
+  if (header.baked_h > atlas_size) {
+    header.baked_h = atlas_size;
+  }
+
+  *baked_len = sizeof(header) + sizeof(BakedFontGlyph) * header.num_glyphs + (size_t)atlas_size * header.baked_h;
+  unsigned char *baked = (unsigned char *)alloc(*baked_len);
+  if (baked) {
+    memcpy(baked, &header, sizeof(header));
+    BakedFontGlyph *glyphs = (BakedFontGlyph *)(baked + sizeof(header));
+    for (int i = 0; i < BAKED_FONT_ATLAS_NUM_CODEPOINTS; ++i) {
+      glyphs[i].codepoint = BAKED_FONT_ATLAS_FIRST_CODEPOINT + i;
+      glyphs[i].packed_char = packed_chars[i];
+    }
+    memcpy(glyphs + header.num_glyphs, pixels, (size_t)atlas_size * header.baked_h);
+  }
+  dealloc(pixels);
+  return baked;
+}
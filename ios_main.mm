@@ -18,18 +18,28 @@
 
 static Program *program = CALLOC(Program, 1);
 
+// the on screen text with the status label over its top left corner
+static void render_frame() {
+  auto *text = &program->on_screen_text;
+  render_on_screen_text(program);
+  char status[64];
+  snprintf(status, sizeof(status), "%u bytes, %d px down", str_len(text->text), (int)text->scroll_y);
+  set_text_label(&program->fonts, &program->status_label, status, text->layout.font, 0, 0x808080ff);
+  draw_text_label(program, use_glyphs_shader(program), &program->status_label, 16, 16);
+  glDisable(GL_BLEND);
+  gl_swap_buffers(&program->opengl_es);
+}
+
 @interface KeyboardView : UIView <UIKeyInput>
 @end
 @implementation KeyboardView
 - (void)insertText:(NSString *)text {
-  int c_str_len = (int)text.length;
-  const char *c_str = text.UTF8String;
-  for (int i = 0; i < c_str_len; ++i) {
-    add_char_to_on_screen_text_verts_buf(program, c_str[i]);
-  }
-  render_on_screen_text(program);
+  add_chars_to_on_screen_text(program, text.UTF8String);
+  render_frame();
 }
 - (void)deleteBackward {
+  delete_last_char_of_on_screen_text(program);
+  render_frame();
 }
 - (BOOL)hasText {
   return YES;
@@ -42,6 +52,7 @@ static Program *program = CALLOC(Program, 1);
 @interface OpenGLView : GLKView
 - (void)drawRect:(CGRect)rect;
 - (void)touchesBegan:(NSSet<UITouch *> *)touches withEvent:(UIEvent *)event;
+- (void)touchesMoved:(NSSet<UITouch *> *)touches withEvent:(UIEvent *)event;
 - (void)touchesEnded:(NSSet<UITouch *> *)touches withEvent:(UIEvent *)event;
 @end
 @implementation OpenGLView
@@ -60,10 +71,37 @@ static Program *program = CALLOC(Program, 1);
     [keyboard_view resignFirstResponder];
   }
 }
+- (void)touchesMoved:(NSSet<UITouch *> *)touches withEvent:(UIEvent *)event {
+  UITouch *touch = [touches anyObject];
+  CGFloat dy = [touch previousLocationInView:self].y - [touch locationInView:self].y;
+  scroll_on_screen_text(program, (float)(dy * self.contentScaleFactor)); // points to pixels
+  render_frame();
+}
 - (void)touchesEnded:(NSSet<UITouch *> *)touches withEvent:(UIEvent *)event {
 }
 @end
 
+// called on the font load thread
+static bool map_bundle_file(Program::FontLoad *load, const char *path, FileMap *map) {
+  @autoreleasepool {
+    NSString *full_path = [[[NSBundle mainBundle] resourcePath] stringByAppendingPathComponent:@(path)];
+    return map_file(map, full_path.fileSystemRepresentation);
+  }
+}
+
+static void dispatch_font_load_to_main_queue(Program::FontLoad *load) {
+  OpenGLView *opengl_view = (__bridge OpenGLView *)load->platform_data;
+  dispatch_async(dispatch_get_main_queue(), ^{
+    if (!finish_font_load(program)) {
+      LOGW("no font for on screen text");
+    } else if (str_len(program->on_screen_text.text) > 0) {
+      render_frame();
+    } else {
+      [opengl_view setNeedsDisplay];
+    }
+  });
+}
+
 @interface OpenGLViewController : UIViewController
 - (void)loadView;
 - (void)viewDidLoad;
@@ -82,15 +120,24 @@ static Program *program = CALLOC(Program, 1);
   self.view = opengl_view;
 }
 - (void)viewDidLoad {
-  init_opengl_es_shaders(&program->opengl_es.shaders);
-  NSString *font_path = [[NSBundle mainBundle] pathForResource:@"OpenSans-Regular" ofType:@"ttf" inDirectory:@"assets/fonts/open-sans"];
-  assert(font_path != nil);
-  NSData *font_ns_data = [NSData dataWithContentsOfFile:font_path];
-  NSInteger font_ns_data_len = [font_ns_data length];
-  byte *font_data = MALLOC(byte, (int)font_ns_data_len);
-  memcpy(font_data, [font_ns_data bytes], font_ns_data_len);
-  init_font(&program->font, font_data);
-  init_font_atlas_texture(&program->font);
+  bool scratch_arena_ok = init_arena(&program->scratch_arena, 256 * 1024);
+  assert(scratch_arena_ok);
+  init_opengl_es_shaders(&program->opengl_es.shaders, &program->scratch_arena);
+  init_opengl_es_quad_index_buf(&program->opengl_es);
+  init_worker_pool(&program->worker_pool);
+  bool fonts_ok = init_fonts(&program->fonts);
+  assert(fonts_ok);
+  program->fonts.worker_pool = &program->worker_pool;
+  init_font_atlas_texture(&program->fonts);
+  auto *load = &program->font_load; // the first frames go out without text
+  load->ttf_path = "assets/fonts/open-sans/OpenSans-Regular.ttf";
+  load->baked_atlas_path = "assets/fonts/open-sans/OpenSans-Regular.atlas";
+  load->size = 64;
+  load->sdf = program->fonts.sdf;
+  load->map_file = map_bundle_file;
+  load->done = dispatch_font_load_to_main_queue;
+  load->platform_data = (__bridge void *)self.view;
+  start_font_load(load);
 }
 @end
 
@@ -111,11 +158,7 @@ static Program *program = CALLOC(Program, 1);
 - (void)applicationDidBecomeActive:(UIApplication *)application {
   render_font_atlas(program);
   str_set_c(&program->on_screen_text.text, "");
-  program->on_screen_text.gl_verts_buf_size_in_use = 0;
-  int ascent;
-  stbtt_GetFontVMetrics(&program->font.info, &ascent, nullptr, nullptr);
-  program->on_screen_text.pen_pos_x = 0;
-  program->on_screen_text.pen_pos_y = ascent * program->font.scale_factor + 250;
+  reset_on_screen_text_layout(program);
   LOGI("applicationDidBecomeActive");
 }
 - (void)applicationWillResignActive:(UIApplication *)application {
@@ -128,11 +171,20 @@ static Program *program = CALLOC(Program, 1);
   LOGI("applicationWillEnterForeground");
 }
 - (void)applicationWillTerminate:(UIApplication *)application {
+  delete_text_label(&program->status_label);
   LOGI("applicationWillTerminate");
 }
+- (void)applicationDidReceiveMemoryWarning:(UIApplication *)application {
+  LOGI("applicationDidReceiveMemoryWarning");
+  #ifdef TRACK_ALLOCATIONS
+  log_alloc_sites();
+  write_alloc_sites_folded([NSTemporaryDirectory() stringByAppendingPathComponent:@"heap.folded"].UTF8String);
+  #endif
+}
 @end
 
 int main(int argc, char * argv[]) {
+  install_pool_allocator(); // program itself was CALLOCed before this, but is never freed
   @autoreleasepool {
       return UIApplicationMain(argc, argv, nil, NSStringFromClass([AppDelegate class]));
   }
@@ -48,6 +48,17 @@
 #define LOGF(...) (fprintf(stderr, __VA_ARGS__), fprintf(stderr, "\n"))
 #endif
 
+#if !defined(__ANDROID__) && !defined(__APPLE__) // host builds of tools/host_tests.cpp, no surface to swap to
+#include <stdio.h>
+#include <GLES3/gl3.h>
+
+#define LOGD(...) (fprintf(stderr, __VA_ARGS__), fprintf(stderr, "\n"))
+#define LOGI(...) (fprintf(stderr, __VA_ARGS__), fprintf(stderr, "\n"))
+#define LOGW(...) (fprintf(stderr, __VA_ARGS__), fprintf(stderr, "\n"))
+#define LOGE(...) (fprintf(stderr, __VA_ARGS__), fprintf(stderr, "\n"))
+#define LOGF(...) (fprintf(stderr, __VA_ARGS__), fprintf(stderr, "\n"))
+#endif
+
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -56,18 +67,30 @@
 #include <netdb.h>
 #include <pthread.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <stdatomic.h>
+#include <math.h>
+#include <float.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 
 #define STB_RECT_PACK_IMPLEMENTATION
 #include "stb_rect_pack.h"
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb_truetype.h"
+#include "baked_font_atlas.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #define HTTP_PARSER_IMPLEMENTATION
 #include "http_parser.h"
 
+typedef int8_t int8;
+typedef uint8_t uint8;
 typedef int16_t int16;
 typedef uint16_t uint16;
 typedef int32_t int32;
@@ -86,10 +109,128 @@ static void *(*lyc_calloc)(size_t nmemb, size_t size) = ::calloc;
 static void *(*lyc_realloc)(void *ptr, size_t size) = ::realloc;
 static void (*lyc_free)(void *ptr) = ::free;
 
+#ifdef TRACK_ALLOCATIONS
+// opt in heap profiling: every MALLOC/CALLOC site keeps lock free counters of the memory it holds,
+// a block stays attributed to the site that first allocated it across REALLOCs
+struct AllocSite {
+  const char *file;
+  int line;
+  _Atomic(int) registered;
+  _Atomic(int64) live_bytes;
+  _Atomic(int64) peak_bytes;
+  _Atomic(int64) live_count;
+  _Atomic(int64) total_count;
+  AllocSite *next;
+};
+
+struct AllocSiteHeader { // 16 bytes on every abi, so the block keeps the alignment the allocator gave it
+  uint64 size;
+  union {
+    AllocSite *site;
+    uint64 site_storage;
+  };
+};
+
+static _Atomic(AllocSite *) alloc_sites;
+
+void alloc_site_add(AllocSite *site, int64 size, int64 count) {
+  if (!atomic_load(&site->registered)) {
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&site->registered, &expected, 1)) {
+      AllocSite *head = atomic_load(&alloc_sites);
+      do {
+        site->next = head;
+      } while (!atomic_compare_exchange_weak(&alloc_sites, &head, site));
+    }
+  }
+  int64 live_bytes = atomic_fetch_add(&site->live_bytes, size) + size;
+  int64 peak_bytes = atomic_load(&site->peak_bytes);
+  while (live_bytes > peak_bytes && !atomic_compare_exchange_weak(&site->peak_bytes, &peak_bytes, live_bytes)) {
+  }
+  atomic_fetch_add(&site->live_count, count);
+  atomic_fetch_add(&site->total_count, count);
+}
+
+void *tracked_malloc(AllocSite *site, size_t size) {
+  AllocSiteHeader *header = (AllocSiteHeader *)lyc_malloc(sizeof(AllocSiteHeader) + size);
+  if (!header) {
+    return nullptr;
+  }
+  header->site = site;
+  header->size = size;
+  alloc_site_add(site, size, 1);
+  return header + 1;
+}
+
+void *tracked_calloc(AllocSite *site, size_t nmemb, size_t size) {
+  AllocSiteHeader *header = (AllocSiteHeader *)lyc_calloc(1, sizeof(AllocSiteHeader) + nmemb * size);
+  if (!header) {
+    return nullptr;
+  }
+  header->site = site;
+  header->size = nmemb * size;
+  alloc_site_add(site, nmemb * size, 1);
+  return header + 1;
+}
+
+void *tracked_realloc(AllocSite *site, void *ptr, size_t size) {
+  if (!ptr) {
+    return tracked_malloc(site, size);
+  }
+  AllocSiteHeader *header = (AllocSiteHeader *)ptr - 1;
+  int64 old_size = header->size;
+  header = (AllocSiteHeader *)lyc_realloc(header, sizeof(AllocSiteHeader) + size);
+  if (!header) {
+    return nullptr;
+  }
+  header->size = size;
+  alloc_site_add(header->site, (int64)size - old_size, 0);
+  return header + 1;
+}
+
+void tracked_free(void *ptr) {
+  if (ptr) {
+    AllocSiteHeader *header = (AllocSiteHeader *)ptr - 1;
+    atomic_fetch_sub(&header->site->live_bytes, (int64)header->size);
+    atomic_fetch_sub(&header->site->live_count, (int64)1);
+    lyc_free(header);
+  }
+}
+
+void log_alloc_sites() {
+  LOGI("allocation sites (live bytes, live count, peak bytes, total count):");
+  for (AllocSite *site = atomic_load(&alloc_sites); site; site = site->next) {
+    LOGI("  %s:%d %lld %lld %lld %lld", site->file, site->line, (long long)atomic_load(&site->live_bytes),
+         (long long)atomic_load(&site->live_count), (long long)atomic_load(&site->peak_bytes), (long long)atomic_load(&site->total_count));
+  }
+}
+
+bool write_alloc_sites_folded(const char *path) { // live bytes per site in flamegraph.pl's folded stack format
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    return false;
+  }
+  for (AllocSite *site = atomic_load(&alloc_sites); site; site = site->next) {
+    int64 live_bytes = atomic_load(&site->live_bytes);
+    if (live_bytes > 0) {
+      fprintf(file, "heap;%s:%d %lld\n", site->file, site->line, (long long)live_bytes);
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+#define ALLOC_SITE ([]() -> AllocSite * { static AllocSite site = {__FILE__, __LINE__}; return &site; }())
+#define MALLOC(type, num) ((type *)(tracked_malloc(ALLOC_SITE, (num) * sizeof(type))))
+#define CALLOC(type, num) ((type *)(tracked_calloc(ALLOC_SITE, (num), sizeof(type))))
+#define REALLOC(ptr, type, num) ((type *)(tracked_realloc(ALLOC_SITE, (ptr), (num) * sizeof(type))))
+#define FREE(ptr) (tracked_free(ptr))
+#else
 #define MALLOC(type, num) ((type *)(lyc_malloc((num) * sizeof(type))))
 #define CALLOC(type, num) ((type *)(lyc_calloc((num), sizeof(type))))
 #define REALLOC(ptr, type, num) ((type *)(lyc_realloc((ptr), (num) * sizeof(type))))
 #define FREE(ptr) (lyc_free(ptr))
+#endif
 
 template <typename F>
 struct ScopeExit {
@@ -110,10 +251,6 @@ ScopeExit<F> make_scope_exit(F f) {
   float buf[] = {x, y, z, s0, t0, x + w, y, z, s1, t0, x, y + h, z, s0, t1,         \
                  x, y + h, z, s0, t1, x + w, y, z, s1, t0, x + w, y + h, z, s1, t1};
 
-#define QUAD_VERTS_XYZ_RGBA_ST(buf, x, y, z, w, h, r, g, b, a, s0, t0, s1, t1)                                           \
-  float buf[] = {x, y, z, r, g, b, a, s0, t0, x + w, y, z, r, g, b, a, s1, t0, x, y + h, z, r, g, b, a, s0, t1,          \
-                 x, y + h, z, r, g, b, a, s0, t1, x + w, y, z, r, g, b, a, s1, t0, x + w, y + h, z, r, g, b, a, s1, t1};
-
 namespace { // simple math
 template <typename T>
 T max(T a, T b) {
@@ -133,15 +270,58 @@ T min(T a, T b) {
                  -(right + left) / (right - left), -(top + bottom) / (top - bottom), -(far + near) / (far - near), 1};
 } // simple math
 
-namespace { // simple dynamic string
-#define STRING_INIT_CAPACITY 64u
-#define STRING_GROWTH_FACTOR 2u
+namespace { // container growth policy
+#ifndef CONTAINER_GROWTH_FACTOR
+#define CONTAINER_GROWTH_FACTOR 2.0
+#endif
+static_assert(CONTAINER_GROWTH_FACTOR > 1.0, "container growth factor must be greater than 1");
+
+#ifdef CONTAINER_STATS
+struct ContainerStats {
+  uint32 num_reallocs;
+  uint64 bytes_moved; // only counts reallocs that actually moved the block
+};
+#endif
+
+// every growing container goes through here, so amortized O(1) append holds for all of them
+uint32 container_grow_capacity(uint32 capacity, uint32 required, uint32 init_capacity) {
+  uint64 grown = (uint64)(capacity * (double)CONTAINER_GROWTH_FACTOR);
+  uint64 new_capacity = max((uint64)init_capacity, max((uint64)required, grown));
+  if (new_capacity > UINT32_MAX) {
+    assert(required <= UINT32_MAX);
+    new_capacity = UINT32_MAX;
+  }
+  return (uint32)new_capacity;
+}
+
+template <typename H>
+H *container_realloc(H *header, size_t old_size, size_t new_size) {
+  (void)old_size;
+  #ifdef CONTAINER_STATS
+  uintptr_t old_addr = (uintptr_t)header;
+  #endif
+  H *new_header = (H *)REALLOC(header, char, new_size);
+  #ifdef CONTAINER_STATS
+  new_header->stats.num_reallocs += 1;
+  if ((uintptr_t)new_header != old_addr) {
+    new_header->stats.bytes_moved += min(old_size, new_size);
+  }
+  #endif
+  return new_header;
+}
+} // container growth policy
 
+namespace { // simple dynamic string
 struct StringHeader {
+  #ifdef CONTAINER_STATS
+  ContainerStats stats;
+  #endif
   uint32 len;
-  uint32 free;
+  uint32 free; // not counting the terminator
 };
 
+#define STRING_INIT_CAPACITY (uint32)(64 - sizeof(StringHeader) - 1) // 64 bytes together with header and terminator
+
 void delete_str(char *str) {
   if (str) {
     FREE(str - sizeof(StringHeader));
@@ -156,10 +336,71 @@ uint32 str_len(const char *str) {
   }
 }
 
+uint32 str_capacity(const char *str) {
+  if (str) {
+    StringHeader *header = (StringHeader *)(str) - 1;
+    return header->len + header->free;
+  } else {
+    return 0;
+  }
+}
+
+#ifdef CONTAINER_STATS
+ContainerStats str_stats(const char *str) {
+  if (str) {
+    return ((StringHeader *)(str) - 1)->stats;
+  } else {
+    return {};
+  }
+}
+#endif
+
+void str_set_capacity(char **str, uint32 capacity) {
+  assert(str);
+  if (!*str) {
+    StringHeader *header = (StringHeader *)MALLOC(char, sizeof(StringHeader) + capacity + 1);
+    *header = {};
+    header->free = capacity;
+    *str = (char *)(header + 1);
+    **str = '\0';
+  } else {
+    StringHeader *header = (StringHeader *)(*str) - 1;
+    uint32 old_capacity = header->len + header->free;
+    assert(capacity >= header->len);
+    if (capacity != old_capacity) {
+      header = container_realloc(header, sizeof(StringHeader) + old_capacity + 1, sizeof(StringHeader) + capacity + 1);
+      header->free = capacity - header->len;
+      *str = (char *)(header + 1);
+    }
+  }
+}
+
+void str_grow(char **str, uint32 required_capacity) {
+  uint32 capacity = str_capacity(*str);
+  if (!*str || capacity < required_capacity) {
+    str_set_capacity(str, container_grow_capacity(capacity, required_capacity, STRING_INIT_CAPACITY));
+  }
+}
+
+void str_reserve(char **str, uint32 capacity) { // exact, the growth factor is not applied
+  if (!*str || str_capacity(*str) < capacity) {
+    str_set_capacity(str, capacity);
+  }
+}
+
+void str_shrink_to_fit(char **str) {
+  assert(str);
+  if (*str) {
+    str_set_capacity(str, str_len(*str));
+  }
+}
+
 int str_cmp_impl(const char *str1, const char *str2, uint32 str2_len) {
   uint32 str1_len = str_len(str1);
   if (str1_len != str2_len) {
     return str1_len > str2_len ? 1 : -1;
+  } else if (str1_len == 0) {
+    return 0;
   } else {
     return memcmp(str1, str2, str1_len);
   }
@@ -175,29 +416,18 @@ int str_cmp_c(const char *str1, const char *str2) {
 
 void str_set_impl(char **str1, const char *str2, uint32 str2_len) {
   assert(str1);
-  if (!*str1) {
-    uint32 size = max((uint32)((sizeof(StringHeader) + str2_len + 1) * STRING_GROWTH_FACTOR), STRING_INIT_CAPACITY);
-    char *new_str = MALLOC(char, size);
-    ((StringHeader *)new_str)->len = str2_len;
-    ((StringHeader *)new_str)->free = size - sizeof(StringHeader) - str2_len - 1;
-    memcpy(new_str + sizeof(StringHeader), str2, str2_len + 1);
-    *str1 = new_str + sizeof(StringHeader);
-  } else {
-    StringHeader *header = (StringHeader *)(*str1) - 1;
-    uint32 capacity = header->len + 1 + header->free;
-    if (capacity > str2_len) {
-      header->len = str2_len;
-      header->free = capacity - str2_len - 1;
-      memcpy(*str1, str2, str2_len + 1);
-    } else {
-      uint32 new_size = (uint32)((sizeof(StringHeader) + str2_len + 1) * STRING_GROWTH_FACTOR);
-      header = (StringHeader*)REALLOC(header, char, new_size);
-      *str1 = (char*)(header + 1);
-      header->len = str2_len;
-      header->free = new_size - sizeof(StringHeader) - str2_len - 1;
-      memcpy(*str1, str2, str2_len + 1);
-    }
+  assert(str2 || str2_len == 0);
+  if (*str1 == str2) {
+    return;
   }
+  str_grow(str1, str2_len);
+  StringHeader *header = (StringHeader *)(*str1) - 1;
+  header->free = header->len + header->free - str2_len;
+  header->len = str2_len;
+  if (str2_len) {
+    memmove(*str1, str2, str2_len);
+  }
+  (*str1)[str2_len] = '\0';
 }
 
 void str_set(char **str1, const char *str2) {
@@ -230,50 +460,32 @@ char* str_dup_c(const char *str) {
 
 void str_cat(char **str, char c) {
   assert(str);
-  if (!*str) {
-    uint32 size = STRING_INIT_CAPACITY;
-    char *new_str = MALLOC(char, size);
-    ((StringHeader *)new_str)->len = 1;
-    ((StringHeader *)new_str)->free = size - sizeof(StringHeader) - 1 - 1;
-    *(new_str + sizeof(StringHeader)) = c;
-    *(new_str + sizeof(StringHeader) + 1) = '\0';
-    *str = new_str + sizeof(StringHeader);
-  } else {
-    StringHeader *header = (StringHeader *)(*str) - 1;
-    if (header->free < 1) {
-      uint32 new_size = (uint32)((sizeof(StringHeader) + header->len + 1 + 1) * STRING_GROWTH_FACTOR);
-      header = (StringHeader *)REALLOC(header, char, new_size);
-      header->free = new_size - sizeof(StringHeader) - header->len - 1;
-      *str = (char*)(header + 1);
-    }
-    header->len += 1;
-    header->free -= 1;
-    *(*str + header->len - 1) = c;
-    *(*str + header->len) = '\0';
-  }
+  str_grow(str, str_len(*str) + 1);
+  StringHeader *header = (StringHeader *)(*str) - 1;
+  header->len += 1;
+  header->free -= 1;
+  *(*str + header->len - 1) = c;
+  *(*str + header->len) = '\0';
 }
 
 void str_cat_impl(char **str1, const char *str2, uint32 str2_len) {
   assert(str1);
-  if (!*str1) {
-    uint32 size = max((uint32)((sizeof(StringHeader) + str2_len + 1) * STRING_GROWTH_FACTOR), STRING_INIT_CAPACITY);
-    char *new_str = MALLOC(char, size);
-    ((StringHeader *)new_str)->len = str2_len;
-    ((StringHeader *)new_str)->free = size - sizeof(StringHeader) - str2_len - 1;
-    memcpy(new_str + sizeof(StringHeader), str2, str2_len + 1);
-    *str1 = new_str + sizeof(StringHeader);
+  assert(str2 || str2_len == 0);
+  uint32 str1_len = str_len(*str1);
+  if (*str1 && str2 >= *str1 && str2 <= *str1 + str1_len) { // appending part of itself, survive the realloc
+    uint32 offset = str2 - *str1;
+    str_grow(str1, str1_len + str2_len);
+    str2 = *str1 + offset;
   } else {
-    StringHeader *header = (StringHeader *)(*str1) - 1;
-    if (header->free < str2_len) {
-      uint32 new_size = (uint32)((sizeof(StringHeader) + header->len + 1 + str2_len) * STRING_GROWTH_FACTOR);
-      header = (StringHeader *)REALLOC(header, char, new_size);
-      header->free = new_size - sizeof(StringHeader) - header->len - 1;
-      *str1 = (char*)(header + 1);
-    }
-    header->len += str2_len;
-    header->free -= str2_len;
-    memcpy(*str1 + header->len - str2_len, str2, str2_len + 1);
+    str_grow(str1, str1_len + str2_len);
+  }
+  StringHeader *header = (StringHeader *)(*str1) - 1;
+  header->len += str2_len;
+  header->free -= str2_len;
+  if (str2_len) {
+    memcpy(*str1 + str1_len, str2, str2_len);
   }
+  (*str1)[header->len] = '\0';
 }
 
 void str_cat(char **str1, const char *str2) {
@@ -284,6 +496,22 @@ void str_cat_c(char **str1, const char *str2) {
   str_cat_impl(str1, str2, strlen(str2));
 }
 
+void str_splice(char **str, uint32 begin, uint32 end, const char *chars, uint32 chars_len) { // chars replace [begin, end)
+  assert(str);
+  uint32 len = str_len(*str);
+  assert(begin <= end && end <= len);
+  assert(!*str || chars + chars_len <= *str || chars >= *str + len + 1);
+  uint32 new_len = len - (end - begin) + chars_len;
+  str_grow(str, new_len);
+  StringHeader *header = (StringHeader *)(*str) - 1;
+  memmove(*str + begin + chars_len, *str + end, len - end + 1);
+  if (chars_len) {
+    memcpy(*str + begin, chars, chars_len);
+  }
+  header->free = header->len + header->free - new_len;
+  header->len = new_len;
+}
+
 void str_pop(char *str, uint32 n) {
   assert(str);
   StringHeader *header = (StringHeader *)(str) - 1;
@@ -293,26 +521,23 @@ void str_pop(char *str, uint32 n) {
   str[header->len] = '\0';
 }
 
-void str_pop_to_char(char *str, char c) {
+void str_pop_to_char(char *str, char c) { // keeps the last c, does nothing if there is none
   assert(str);
   StringHeader *header = (StringHeader *)(str) - 1;
-  if (header->len > 1) {
-    char *end = str + header->len - 1;
-    while (*end != c && end != str) {
-      --end;
-    }
-    if (end != str) {
-      *(end + 1) = '\0';
-      uint32 old_len = header->len;
-      header->len = (end + 1) - str;
-      header->free += (old_len - header->len);
-    }
+  uint32 new_len = header->len;
+  while (new_len > 0 && str[new_len - 1] != c) {
+    --new_len;
+  }
+  if (new_len > 0) {
+    header->free += header->len - new_len;
+    header->len = new_len;
+    str[new_len] = '\0';
   }
 }
 
 void str_replace(char *str, char a, char b) {
   uint32 len = str_len(str);
-  for (int i = 0; i < len; ++i) {
+  for (uint32 i = 0; i < len; ++i) {
     if (str[i] == a) {
       str[i] = b;
     }
@@ -322,9 +547,11 @@ void str_replace(char *str, char a, char b) {
 
 namespace { // simple dynamic array
 #define ARRAY_INIT_CAPACITY 64u
-#define ARRAY_GROWTH_FACTOR 2u
 
 struct ArrayHeader {
+  #ifdef CONTAINER_STATS
+  ContainerStats stats;
+  #endif
   uint32 size;
   uint32 free;
 };
@@ -346,6 +573,16 @@ uint32 array_size(const T *array) {
   }
 }
 
+template <typename T>
+uint32 array_capacity(const T *array) {
+  if (array) {
+    ArrayHeader *header = (ArrayHeader *)((char *)array - sizeof(ArrayHeader));
+    return header->size + header->free;
+  } else {
+    return 0;
+  }
+}
+
 template <typename T>
 ArrayHeader *array_header(const T *array) {
   assert(array);
@@ -353,6 +590,17 @@ ArrayHeader *array_header(const T *array) {
   return header;
 }
 
+#ifdef CONTAINER_STATS
+template <typename T>
+ContainerStats array_stats(const T *array) {
+  if (array) {
+    return array_header(array)->stats;
+  } else {
+    return {};
+  }
+}
+#endif
+
 template <typename T>
 T array_last(const T *array) {
   uint32 size = array_size(array);
@@ -361,59 +609,58 @@ T array_last(const T *array) {
 }
 
 template <typename T>
-void array_reserve(T **array, uint32 num_items) {
+void array_set_capacity(T **array, uint32 capacity) {
   assert(array);
   if (!*array) {
-    char *new_array = MALLOC(char, sizeof(ArrayHeader) + num_items * sizeof(T));
-    ArrayHeader *header = (ArrayHeader *)new_array;
-    header->size = 0;
-    header->free = num_items;
-    *array = (T *)(new_array + sizeof(ArrayHeader));
+    ArrayHeader *header = (ArrayHeader *)MALLOC(char, sizeof(ArrayHeader) + capacity * sizeof(T));
+    *header = {};
+    header->free = capacity;
+    *array = (T *)(header + 1);
   } else {
-    ArrayHeader *header = (ArrayHeader *)((char *)(*array) - sizeof(ArrayHeader));
-    if ((header->size + header->free) < num_items) {
-      char *new_array = REALLOC(header, char, sizeof(ArrayHeader) + num_items * sizeof(T));
-      header = (ArrayHeader *)new_array;
-      *array = (T *)(new_array + sizeof(ArrayHeader));
-      header->free = num_items - header->size;
+    ArrayHeader *header = array_header(*array);
+    uint32 old_capacity = header->size + header->free;
+    assert(capacity >= header->size);
+    if (capacity != old_capacity) {
+      header = container_realloc(header, sizeof(ArrayHeader) + old_capacity * sizeof(T), sizeof(ArrayHeader) + capacity * sizeof(T));
+      header->free = capacity - header->size;
+      *array = (T *)(header + 1);
     }
   }
 }
 
+template <typename T>
+void array_grow(T **array, uint32 required_capacity) {
+  uint32 capacity = array_capacity(*array);
+  if (!*array || capacity < required_capacity) {
+    array_set_capacity(array, container_grow_capacity(capacity, required_capacity, ARRAY_INIT_CAPACITY));
+  }
+}
+
+template <typename T>
+void array_reserve(T **array, uint32 num_items) { // exact, the growth factor is not applied
+  if (!*array || array_capacity(*array) < num_items) {
+    array_set_capacity(array, num_items);
+  }
+}
+
+template <typename T>
+void array_shrink_to_fit(T **array) {
+  assert(array);
+  if (*array) {
+    array_set_capacity(array, array_size(*array));
+  }
+}
+
 template <typename T>
 void array_resize(T **array, uint32 new_size) {
   assert(array);
-  if (!*array) {
-    uint32 capacity = new_size * ARRAY_GROWTH_FACTOR;
-    char *new_array = CALLOC(char, sizeof(ArrayHeader) + capacity * sizeof(T));
-    ArrayHeader *header = (ArrayHeader *)new_array;
-    header->size = new_size;
-    header->free = capacity - new_size;
-    *array = (T *)(new_array + sizeof(ArrayHeader));
-  } else {
-    ArrayHeader *header = (ArrayHeader *)((char *)(*array) - sizeof(ArrayHeader));
-    if (header->size >= new_size) {
-      uint32 diff = header->size - new_size;
-      header->size -= diff;
-      header->free += diff;
-    } else {
-      uint32 capacity = header->size + header->free;
-      if (new_size <= capacity) {
-        uint32 diff = new_size - header->size;
-        header->size += diff;
-        header->free -= diff;
-        memset(*array + (header->size - diff), 0, diff * sizeof(T));
-      } else {
-        uint32 new_capacity = new_size * ARRAY_GROWTH_FACTOR;
-        char *new_array = REALLOC(header, char, sizeof(ArrayHeader) + new_capacity * sizeof(T));
-        header = (ArrayHeader *)new_array;
-        uint32 old_size = header->size;
-        header->size = new_size;
-        header->free = new_capacity - new_size;
-        *array = (T *)(new_array + sizeof(ArrayHeader));
-        memset(*array + old_size, 0, (new_size - old_size) * sizeof(T));
-      }
-    }
+  uint32 old_size = array_size(*array);
+  array_grow(array, new_size);
+  ArrayHeader *header = array_header(*array);
+  header->free = header->size + header->free - new_size;
+  header->size = new_size;
+  if (new_size > old_size) {
+    memset(*array + old_size, 0, (new_size - old_size) * sizeof(T));
   }
 }
 
@@ -427,51 +674,31 @@ void array_set(T *array, T value) {
 template <typename T>
 void array_push(T **array, const T &item) {
   assert(array);
-  if (!*array) {
-    char *new_array = MALLOC(char, sizeof(ArrayHeader) + ARRAY_INIT_CAPACITY * sizeof(T));
-    ArrayHeader *header = (ArrayHeader *)new_array;
-    header->size = 1;
-    header->free = ARRAY_INIT_CAPACITY - 1;
-    *(T *)(new_array + sizeof(ArrayHeader)) = item;
-    *array = (T *)(new_array + sizeof(ArrayHeader));
-  } else {
-    ArrayHeader *header = (ArrayHeader *)((char *)(*array) - sizeof(ArrayHeader));
-    if (header->free == 0) {
-      uint32 new_capacity = header->size * ARRAY_GROWTH_FACTOR;
-      char *new_array = REALLOC(header, char, sizeof(ArrayHeader) + new_capacity * sizeof(T));
-      header = (ArrayHeader *)new_array;
-      header->free = new_capacity - header->size;
-      *array = (T *)(new_array + sizeof(ArrayHeader));
-    }
-    header->size += 1;
-    header->free -= 1;
-    (*array)[header->size - 1] = item;
-  }
+  T copy = item; // item may live in the array, copy it before the realloc
+  array_grow(array, array_size(*array) + 1);
+  ArrayHeader *header = array_header(*array);
+  header->size += 1;
+  header->free -= 1;
+  (*array)[header->size - 1] = copy;
 }
 
 template <typename T>
 void array_push(T **array, const T *items, uint32 num_items) {
   assert(array);
-  if (!*array) {
-    uint32 capacity = max(ARRAY_INIT_CAPACITY, num_items * ARRAY_GROWTH_FACTOR);
-    char *new_array = MALLOC(char, sizeof(ArrayHeader) + capacity * sizeof(T));
-    ArrayHeader *header = (ArrayHeader *)new_array;
-    header->size = num_items;
-    header->free = ARRAY_INIT_CAPACITY - num_items;
-    memcpy(new_array + sizeof(ArrayHeader), items, num_items * sizeof(T));
-    *array = (T *)(new_array + sizeof(ArrayHeader));
+  assert(items || num_items == 0);
+  uint32 size = array_size(*array);
+  if (*array && items >= *array && items < *array + size) { // pushing its own items, survive the realloc
+    uint32 offset = items - *array;
+    array_grow(array, size + num_items);
+    items = *array + offset;
   } else {
-    ArrayHeader *header = (ArrayHeader *)((char *)(*array) - sizeof(ArrayHeader));
-    if (header->free < num_items) {
-      uint32 new_capacity = (header->size + num_items) * ARRAY_GROWTH_FACTOR;
-      char *new_array = REALLOC(header, char, sizeof(ArrayHeader) + new_capacity * sizeof(T));
-      header = (ArrayHeader *)new_array;
-      header->free = new_capacity - header->size;
-      *array = (T *)(new_array + sizeof(ArrayHeader));
-    }
-    header->size += num_items;
-    header->free -= num_items;
-    memcpy((*array) + (header->size - num_items), items, num_items * sizeof(T));
+    array_grow(array, size + num_items);
+  }
+  ArrayHeader *header = array_header(*array);
+  header->size += num_items;
+  header->free -= num_items;
+  if (num_items) {
+    memcpy((*array) + size, items, num_items * sizeof(T));
   }
 }
 
@@ -522,305 +749,2871 @@ T array_swap_with_end_then_pop(T *array, uint32 index) {
 }
 } // simple dynamic array
 
-struct Program { // root data structure of the entire program
-  #ifdef __ANDROID__
-  android_app* app;
-  #endif
-  struct OpenGLES {
-    #ifdef __ANDROID__
-    EGLDisplay display;
-    EGLConfig display_config;
-    EGLSurface surface;
-    EGLContext context;
-    #endif
-    int surface_width;
-    int surface_height;
-    struct Shaders {
-      struct Text {
-        GLuint id;
-        GLint uniform_mvp_mat;
-        GLint uniform_tex;
-        GLuint attrib_position;
-        GLuint attrib_color;
-        GLuint attrib_tcoord;
-      } text;
-    } shaders;
-  } opengl_es;
-  struct Font {
-    stbtt_fontinfo info;
-    float scale_factor;
-    stbtt_packedchar *packed_chars; // currently always ascii 32 to 126
-    int num_packed_chars;
-    byte *atlas;
-    int atlas_w;
-    int atlas_h;
-    GLuint atlas_gl_texture_id;
-  } font;
-  struct KeyboardState {
-    bool shift_on;
-  } keyboard_state;
-  struct OnScreenText{
-    char *text;
-    GLuint gl_verts_buf_id; // xyz,rgba,st
-    uint32 gl_verts_buf_size;
-    uint32 gl_verts_buf_size_in_use;
-    float pen_pos_x;
-    float pen_pos_y;
-  } on_screen_text;
-  struct Network {
-    int dns_lookup_pipe[2];
-    struct DNSLookup {
-      _Atomic int status; // 0:not started, 1:start failed 2:in progress, 3:succeed, 4:failed
-      int write_pipe;
-      const char *domain_name;
-      const char *service;
-      addrinfo request;
-      addrinfo *response;
-      DNSLookup *next;
-    } *dns_lookups;
-    struct ConnectionAttempt {
-      int socket_fd;
-      const char *domain_name;
-      addrinfo *addr_list;
-      addrinfo *cur_addr;
-    } *connection_attempts;
-    struct Connection {
-      int socket_fd;
-      const char *domain_name;
-    } *connections;
-  } network;
+// swiss table style: one control byte per slot, probed 16 slots at a time
+template <typename K, typename V>
+struct HashMap {
+  int8 *ctrls; // HASH_MAP_EMPTY, HASH_MAP_DELETED or low 7 bits of the key hash, keys and values live in the same block
+  K *keys;
+  V *values;
+  uint32 capacity; // power of two, multiple of HASH_MAP_GROUP_SIZE
+  uint32 size;
+  uint32 growth_left; // inserts into empty slots allowed before rehash, keeps load under 7/8
 };
 
-void gl_swap_buffers(Program::OpenGLES *opengl_es) {
-  #ifdef __APPLE__
-  [[EAGLContext currentContext] presentRenderbuffer:GL_RENDERBUFFER];
-  #else
-  eglSwapBuffers(opengl_es->display, opengl_es->surface);
-  #endif
+namespace { // open addressing hash map
+#define HASH_MAP_GROUP_SIZE 16u
+#define HASH_MAP_EMPTY ((int8)-128)
+#define HASH_MAP_DELETED ((int8)-2)
+
+uint64 hash_key(uint64 key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdull;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ull;
+  key ^= key >> 33;
+  return key;
 }
 
-void init_opengl_es_shaders(Program::OpenGLES::Shaders *shaders) {
-  struct ProgramSrc {
-    const char *vert_shader;
-    int vert_shader_len;
-    const char *frag_shader;
-    int frag_shader_len;
-  };
-  auto split_src_string = [](const char *src) -> ProgramSrc {
-    #define VS_STAGE_STR "[Vertex Shader Stage]"
-    #define FS_STAGE_STR "[Fragment Shader Stage]"
-    ProgramSrc psrc = {};
-    const char *vsi_pos = strstr(src, VS_STAGE_STR);
-    const char *fsi_pos = strstr(src, FS_STAGE_STR);
-    if (vsi_pos && fsi_pos) {
-      psrc.vert_shader = vsi_pos + strlen(VS_STAGE_STR);
-      psrc.vert_shader_len = fsi_pos - psrc.vert_shader;
-      psrc.frag_shader = fsi_pos + strlen(FS_STAGE_STR);
-      psrc.frag_shader_len = strlen(src) - (psrc.frag_shader - src);
-    }
-    return psrc;
-  };
-  auto compile_shader = [](const char* shader_name, const char *src, int src_len, GLenum shader_type) -> GLuint {
-    GLuint shader_id = glCreateShader(shader_type);
-    if (shader_id == 0) {
-      return 0;
-    }
-    glShaderSource(shader_id, 1, &src, &src_len);
-    glCompileShader(shader_id);
-    GLint logLength;
-    glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &logLength);
-    if (logLength > 0) {
-      GLchar *log = MALLOC(GLchar, logLength);
-      DEFER(FREE(log));
-      glGetShaderInfoLog(shader_id, logLength, &logLength, log);
-      if (strcmp(log, "")) {
-        LOGI("shader \"%s\" compile message:\n%s\n", shader_name, log);
-      }
-    }
-    GLint status;
-    glGetShaderiv(shader_id, GL_COMPILE_STATUS, &status);
-    if (status == GL_FALSE) {
-      glDeleteShader(shader_id);
-      return 0;
-    }
-    return shader_id;
-  };
-  auto link_shader = [](const char* shader_name, GLuint vs_id, GLuint fs_id) -> GLuint {
-    GLuint shader_id = glCreateProgram();
-    if (!shader_id) {
-      return 0;
-    }
-    glAttachShader(shader_id, vs_id);
+uint64 hash_key(uint32 key) { return hash_key((uint64)key); }
+uint64 hash_key(int32 key) { return hash_key((uint64)(uint32)key); }
+
+uint64 hash_key(const char *key) { // fnv-1a
+  uint64 hash = 0xcbf29ce484222325ull;
+  for (; *key; ++key) {
+    hash = (hash ^ (uchar)*key) * 0x100000001b3ull;
+  }
+  return hash_key(hash);
+}
+
+template <typename K>
+bool hash_key_equal(const K &a, const K &b) {
+  return a == b;
+}
+
+bool hash_key_equal(const char *a, const char *b) {
+  return !strcmp(a, b);
+}
+
+// match masks have one set bit per matching slot, at bit (slot << HASH_MAP_MASK_SHIFT)
+#if defined(__SSE2__)
+#define HASH_MAP_MASK_SHIFT 0
+uint64 hash_map_match(const int8 *group, int8 ctrl) {
+  __m128i ctrls = _mm_loadu_si128((const __m128i *)group);
+  return (uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrls, _mm_set1_epi8(ctrl)));
+}
+uint64 hash_map_match_empty_or_deleted(const int8 *group) {
+  return (uint32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HASH_MAP_MASK_SHIFT 2
+uint64 hash_map_neon_mask(uint8x16_t eq) { // one nibble per lane, keep its top bit
+  uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+  return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & 0x8888888888888888ull;
+}
+uint64 hash_map_match(const int8 *group, int8 ctrl) {
+  return hash_map_neon_mask(vceqq_s8(vld1q_s8(group), vdupq_n_s8(ctrl)));
+}
+uint64 hash_map_match_empty_or_deleted(const int8 *group) {
+  return hash_map_neon_mask(vcltq_s8(vld1q_s8(group), vdupq_n_s8(0)));
+}
+#else
+#define HASH_MAP_MASK_SHIFT 0
+uint64 hash_map_match(const int8 *group, int8 ctrl) {
+  uint64 mask = 0;
+  for (uint32 i = 0; i < HASH_MAP_GROUP_SIZE; ++i) {
+    mask |= (uint64)(group[i] == ctrl) << i;
+  }
+  return mask;
+}
+uint64 hash_map_match_empty_or_deleted(const int8 *group) {
+  uint64 mask = 0;
+  for (uint32 i = 0; i < HASH_MAP_GROUP_SIZE; ++i) {
+    mask |= (uint64)(group[i] < 0) << i;
+  }
+  return mask;
+}
+#endif
+
+uint32 hash_map_mask_first(uint64 mask) {
+  return __builtin_ctzll(mask) >> HASH_MAP_MASK_SHIFT;
+}
+
+template <typename K, typename V>
+void delete_hash_map(HashMap<K, V> *map) {
+  FREE(map->ctrls);
+  *map = {};
+}
+
+template <typename K, typename V>
+void hash_map_clear(HashMap<K, V> *map) {
+  if (map->capacity) {
+    memset(map->ctrls, HASH_MAP_EMPTY, map->capacity);
+    map->size = 0;
+    map->growth_left = map->capacity / 8 * 7;
+  }
+}
+
+template <typename K, typename V>
+int64 hash_map_find_slot(const HashMap<K, V> *map, const K &key, uint64 hash) {
+  if (!map->capacity) {
+    return -1;
+  }
+  int8 h2 = (int8)(hash & 0x7f);
+  uint32 group_mask = map->capacity / HASH_MAP_GROUP_SIZE - 1;
+  uint32 group = (uint32)(hash >> 7) & group_mask;
+  for (uint32 probe = 1;; ++probe) {
+    const int8 *ctrls = map->ctrls + group * HASH_MAP_GROUP_SIZE;
+    for (uint64 mask = hash_map_match(ctrls, h2); mask; mask &= mask - 1) {
+      uint32 slot = group * HASH_MAP_GROUP_SIZE + hash_map_mask_first(mask);
+      if (hash_key_equal(map->keys[slot], key)) {
+        return slot;
+      }
+    }
+    if (hash_map_match(ctrls, HASH_MAP_EMPTY)) {
+      return -1;
+    }
+    group = (group + probe) & group_mask; // triangular probing visits every group
+  }
+}
+
+template <typename K, typename V>
+uint32 hash_map_find_free_slot(const HashMap<K, V> *map, uint64 hash) {
+  uint32 group_mask = map->capacity / HASH_MAP_GROUP_SIZE - 1;
+  uint32 group = (uint32)(hash >> 7) & group_mask;
+  for (uint32 probe = 1;; ++probe) {
+    uint64 mask = hash_map_match_empty_or_deleted(map->ctrls + group * HASH_MAP_GROUP_SIZE);
+    if (mask) {
+      return group * HASH_MAP_GROUP_SIZE + hash_map_mask_first(mask);
+    }
+    group = (group + probe) & group_mask;
+  }
+}
+
+template <typename K, typename V>
+void hash_map_rehash(HashMap<K, V> *map, uint32 new_capacity) {
+  assert(new_capacity % HASH_MAP_GROUP_SIZE == 0 && (new_capacity & (new_capacity - 1)) == 0);
+  assert(map->size <= new_capacity / 8 * 7);
+  size_t keys_offset = (new_capacity + alignof(K) - 1) / alignof(K) * alignof(K);
+  size_t values_offset = (keys_offset + new_capacity * sizeof(K) + alignof(V) - 1) / alignof(V) * alignof(V);
+  byte *block = MALLOC(byte, values_offset + new_capacity * sizeof(V));
+  HashMap<K, V> new_map = {};
+  new_map.ctrls = (int8 *)block;
+  new_map.keys = (K *)(block + keys_offset);
+  new_map.values = (V *)(block + values_offset);
+  new_map.capacity = new_capacity;
+  memset(new_map.ctrls, HASH_MAP_EMPTY, new_capacity);
+  for (uint32 i = 0; i < map->capacity; ++i) {
+    if (map->ctrls[i] >= 0) {
+      uint32 slot = hash_map_find_free_slot(&new_map, hash_key(map->keys[i]));
+      new_map.ctrls[slot] = map->ctrls[i];
+      new_map.keys[slot] = map->keys[i];
+      new_map.values[slot] = map->values[i];
+    }
+  }
+  new_map.size = map->size;
+  new_map.growth_left = new_capacity / 8 * 7 - map->size;
+  FREE(map->ctrls);
+  *map = new_map;
+}
+
+template <typename K, typename V>
+void hash_map_reserve(HashMap<K, V> *map, uint32 num_items) {
+  uint32 capacity = max(map->capacity, HASH_MAP_GROUP_SIZE);
+  while (capacity / 8 * 7 < num_items) {
+    capacity *= 2;
+  }
+  if (capacity != map->capacity) {
+    hash_map_rehash(map, capacity);
+  }
+}
+
+template <typename K, typename V>
+V *hash_map_find(const HashMap<K, V> *map, const K &key) {
+  int64 slot = hash_map_find_slot(map, key, hash_key(key));
+  return slot >= 0 ? &map->values[slot] : nullptr;
+}
+
+template <typename K, typename V>
+V *hash_map_insert(HashMap<K, V> *map, const K &key, const V &value) {
+  uint64 hash = hash_key(key);
+  int64 slot = hash_map_find_slot(map, key, hash);
+  if (slot >= 0) {
+    map->values[slot] = value;
+    return &map->values[slot];
+  }
+  if (map->growth_left == 0) {
+    if (map->capacity && map->size < map->capacity / 16 * 7) {
+      hash_map_rehash(map, map->capacity); // mostly tombstones, reclaim them in place
+    } else {
+      hash_map_rehash(map, map->capacity ? map->capacity * 2 : HASH_MAP_GROUP_SIZE);
+    }
+  }
+  slot = hash_map_find_free_slot(map, hash);
+  if (map->ctrls[slot] == HASH_MAP_EMPTY) {
+    map->growth_left -= 1;
+  }
+  map->ctrls[slot] = (int8)(hash & 0x7f);
+  map->keys[slot] = key;
+  map->values[slot] = value;
+  map->size += 1;
+  return &map->values[slot];
+}
+
+template <typename K, typename V>
+bool hash_map_remove(HashMap<K, V> *map, const K &key, V *value = nullptr) {
+  int64 slot = hash_map_find_slot(map, key, hash_key(key));
+  if (slot < 0) {
+    return false;
+  }
+  if (value) {
+    *value = map->values[slot];
+  }
+  // a group that still has an empty slot ends every probe through it, so this slot can become empty again
+  const int8 *group = map->ctrls + slot / HASH_MAP_GROUP_SIZE * HASH_MAP_GROUP_SIZE;
+  if (hash_map_match(group, HASH_MAP_EMPTY)) {
+    map->ctrls[slot] = HASH_MAP_EMPTY;
+    map->growth_left += 1;
+  } else {
+    map->ctrls[slot] = HASH_MAP_DELETED;
+  }
+  map->size -= 1;
+  return true;
+}
+
+template <typename K, typename V, typename F>
+void hash_map_for_each(HashMap<K, V> *map, F func) {
+  for (uint32 i = 0; i < map->capacity; ++i) {
+    if (map->ctrls[i] >= 0) {
+      func(map->keys[i], &map->values[i]);
+    }
+  }
+}
+} // open addressing hash map
+
+// bump allocator for transient work. memory comes from it only through ARENA_ALLOC, never through the lyc_* hooks,
+// and is released at once when the ARENA_SCOPE it was allocated in ends. there is no free, and no realloc, so
+// nothing from an arena can end up in a string or array that outlives the scope
+struct Arena {
+  byte *buf;
+  uint32 capacity;
+  uint32 used;
+};
+
+namespace { // arena allocator
+#define ARENA_ALIGNMENT 16u // what malloc gives on arm64 and x86_64
+
+bool init_arena(Arena *arena, uint32 capacity) {
+  *arena = {};
+  arena->buf = MALLOC(byte, capacity);
+  if (!arena->buf) {
+    return false;
+  }
+  arena->capacity = capacity;
+  return true;
+}
+
+void delete_arena(Arena *arena) {
+  assert(arena->used == 0);
+  FREE(arena->buf);
+  *arena = {};
+}
+
+uint32 arena_push(Arena *arena) {
+  return arena->used;
+}
+
+void arena_pop(Arena *arena, uint32 marker) {
+  assert(marker <= arena->used);
+  arena->used = marker;
+}
+
+bool arena_owns(const Arena *arena, const void *ptr) {
+  return (const byte *)ptr >= arena->buf && (const byte *)ptr < arena->buf + arena->capacity;
+}
+
+// nullptr when the arena is full, callers do without or go to the heap themselves
+void *arena_alloc(Arena *arena, size_t size) {
+  if (size > arena->capacity - arena->used) { // before the round up, which wraps for sizes near SIZE_MAX
+    return nullptr;
+  }
+  size_t block_size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+  if (block_size > arena->capacity - arena->used) {
+    return nullptr;
+  }
+  void *ptr = arena->buf + arena->used;
+  arena->used += (uint32)block_size;
+  return ptr;
+}
+
+struct ArenaScope { // pops the arena back to where it was when the scope began
+  Arena *arena;
+  uint32 marker;
+  ArenaScope(Arena *arena) : arena(arena), marker(arena_push(arena)) {}
+  ~ArenaScope() { arena_pop(arena, marker); }
+};
+
+#define ARENA_SCOPE(arena) ArenaScope STRING_JOIN2(arena_scope_, __LINE__)(arena)
+#define ARENA_ALLOC(arena, type, n) (type *)arena_alloc(arena, sizeof(type) * (n))
+} // arena allocator
+
+namespace { // size class pool allocator
+// blocks up to 2KB come from per thread free lists refilled a chunk at a time, so small object churn
+// never takes the libc heap lock. a block freed by another thread goes onto its owner's lock free
+// remote list and is reclaimed by the owner on its next refill. caches of exited threads are adopted
+// by new ones, free lists and all.
+#define POOL_NUM_SIZE_CLASSES 8u // 16, 32, ... 2048 bytes
+#define POOL_MIN_BLOCK_SHIFT 4u
+#define POOL_LARGE_CLASS 0xffffu
+#define POOL_MAGIC 0xb10cu
+#define POOL_MAX_CACHES 64u
+#define POOL_CHUNK_SIZE (64u * 1024u)
+
+struct PoolBlockHeader { // 16 bytes, so payloads keep the 16 byte alignment malloc gives on arm64 and x86_64
+  uint16 size_class;
+  uint16 magic;
+  uint32 cache_id; // POOL_LARGE_CLASS blocks have no owner
+  uint64 large_size;
+};
+
+struct PoolFreeBlock { // lives in the payload, the header stays valid while a block is free
+  PoolFreeBlock *next;
+};
+
+struct PoolCache {
+  PoolFreeBlock *free_lists[POOL_NUM_SIZE_CLASSES];
+  _Atomic(PoolFreeBlock *) remote_frees;
+  _Atomic(int) in_use;
+};
+
+static PoolCache pool_caches[POOL_MAX_CACHES];
+static thread_local PoolCache *pool_thread_cache = nullptr;
+static pthread_key_t pool_cache_key;
+static pthread_once_t pool_cache_key_once = PTHREAD_ONCE_INIT;
+static pthread_once_t pool_install_once = PTHREAD_ONCE_INIT;
+
+static struct {
+  void *(*malloc)(size_t size);
+  void *(*calloc)(size_t nmemb, size_t size);
+  void *(*realloc)(void *ptr, size_t size);
+  void (*free)(void *ptr);
+} pool_backing_allocator;
+
+uint32 pool_size_class(size_t size) {
+  if (size <= (1u << POOL_MIN_BLOCK_SHIFT)) {
+    return 0;
+  }
+  if (size > (1u << (POOL_MIN_BLOCK_SHIFT + POOL_NUM_SIZE_CLASSES - 1))) {
+    return POOL_LARGE_CLASS;
+  }
+  return 32 - __builtin_clz((uint32)size - 1) - POOL_MIN_BLOCK_SHIFT;
+}
+
+uint32 pool_block_size(uint32 size_class) {
+  return 1u << (size_class + POOL_MIN_BLOCK_SHIFT);
+}
+
+void pool_release_cache(void *cache) { // runs on thread exit
+  pool_thread_cache = nullptr; // later destructors that allocate get a cache of their own again
+  atomic_store(&((PoolCache *)cache)->in_use, 0);
+}
+
+PoolCache *pool_acquire_cache() {
+  pthread_once(&pool_cache_key_once, [] { pthread_key_create(&pool_cache_key, pool_release_cache); });
+  for (uint32 i = 0; i < POOL_MAX_CACHES; ++i) {
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&pool_caches[i].in_use, &expected, 1)) {
+      pthread_setspecific(pool_cache_key, &pool_caches[i]);
+      return &pool_caches[i];
+    }
+  }
+  return nullptr; // more live threads than caches, those allocate straight from the backing allocator
+}
+
+void pool_drain_remote_frees(PoolCache *cache) {
+  PoolFreeBlock *block = atomic_exchange(&cache->remote_frees, (PoolFreeBlock *)nullptr);
+  while (block) {
+    PoolFreeBlock *next = block->next;
+    uint32 size_class = ((PoolBlockHeader *)block - 1)->size_class;
+    block->next = cache->free_lists[size_class];
+    cache->free_lists[size_class] = block;
+    block = next;
+  }
+}
+
+bool pool_refill(PoolCache *cache, uint32 size_class) {
+  byte *chunk = (byte *)pool_backing_allocator.malloc(POOL_CHUNK_SIZE); // chunks stay in the pool for good
+  if (!chunk) {
+    return false;
+  }
+  uint32 stride = sizeof(PoolBlockHeader) + pool_block_size(size_class);
+  for (uint32 offset = 0; offset + stride <= POOL_CHUNK_SIZE; offset += stride) {
+    PoolBlockHeader *header = (PoolBlockHeader *)(chunk + offset);
+    header->size_class = (uint16)size_class;
+    header->magic = POOL_MAGIC;
+    header->cache_id = (uint32)(cache - pool_caches);
+    PoolFreeBlock *block = (PoolFreeBlock *)(header + 1);
+    block->next = cache->free_lists[size_class];
+    cache->free_lists[size_class] = block;
+  }
+  return true;
+}
+
+void *pool_large_malloc(size_t size) {
+  PoolBlockHeader *header = (PoolBlockHeader *)pool_backing_allocator.malloc(sizeof(PoolBlockHeader) + size);
+  if (!header) {
+    return nullptr;
+  }
+  header->size_class = POOL_LARGE_CLASS;
+  header->magic = POOL_MAGIC;
+  header->large_size = size;
+  return header + 1;
+}
+
+void *pool_hook_malloc(size_t size) {
+  uint32 size_class = pool_size_class(size);
+  if (!pool_thread_cache) {
+    pool_thread_cache = pool_acquire_cache();
+  }
+  PoolCache *cache = pool_thread_cache;
+  if (size_class == POOL_LARGE_CLASS || !cache) {
+    return pool_large_malloc(size);
+  }
+  if (!cache->free_lists[size_class]) {
+    pool_drain_remote_frees(cache);
+    if (!cache->free_lists[size_class] && !pool_refill(cache, size_class)) {
+      return nullptr;
+    }
+  }
+  PoolFreeBlock *block = cache->free_lists[size_class];
+  cache->free_lists[size_class] = block->next;
+  return block;
+}
+
+void *pool_hook_calloc(size_t nmemb, size_t size) {
+  if (size && nmemb > SIZE_MAX / size) {
+    return nullptr;
+  }
+  void *ptr = pool_hook_malloc(nmemb * size);
+  if (ptr) {
+    memset(ptr, 0, nmemb * size);
+  }
+  return ptr;
+}
+
+void pool_hook_free(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  PoolBlockHeader *header = (PoolBlockHeader *)ptr - 1;
+  assert(header->magic == POOL_MAGIC);
+  if (header->size_class == POOL_LARGE_CLASS) {
+    pool_backing_allocator.free(header);
+    return;
+  }
+  PoolFreeBlock *block = (PoolFreeBlock *)ptr;
+  PoolCache *owner = &pool_caches[header->cache_id];
+  if (owner == pool_thread_cache) {
+    block->next = owner->free_lists[header->size_class];
+    owner->free_lists[header->size_class] = block;
+  } else {
+    PoolFreeBlock *head = atomic_load(&owner->remote_frees);
+    do {
+      block->next = head;
+    } while (!atomic_compare_exchange_weak(&owner->remote_frees, &head, block));
+  }
+}
+
+void *pool_hook_realloc(void *ptr, size_t size) {
+  if (!ptr) {
+    return pool_hook_malloc(size);
+  }
+  PoolBlockHeader *header = (PoolBlockHeader *)ptr - 1;
+  assert(header->magic == POOL_MAGIC);
+  if (header->size_class == POOL_LARGE_CLASS) {
+    if (pool_size_class(size) == POOL_LARGE_CLASS) {
+      header = (PoolBlockHeader *)pool_backing_allocator.realloc(header, sizeof(PoolBlockHeader) + size);
+      if (!header) {
+        return nullptr;
+      }
+      header->large_size = size;
+      return header + 1;
+    }
+  } else if (size <= pool_block_size(header->size_class)) {
+    return ptr;
+  }
+  void *new_ptr = pool_hook_malloc(size);
+  if (new_ptr) {
+    size_t old_size = header->size_class == POOL_LARGE_CLASS ? header->large_size : pool_block_size(header->size_class);
+    memcpy(new_ptr, ptr, min(old_size, size));
+    pool_hook_free(ptr);
+  }
+  return new_ptr;
+}
+
+// must run before anything that will later be FREEd is allocated.
+// only the first call installs, statics outlive an activity that is recreated in the same process
+void install_pool_allocator() {
+  pthread_once(&pool_install_once, [] {
+    pool_backing_allocator.malloc = lyc_malloc;
+    pool_backing_allocator.calloc = lyc_calloc;
+    pool_backing_allocator.realloc = lyc_realloc;
+    pool_backing_allocator.free = lyc_free;
+    lyc_malloc = pool_hook_malloc;
+    lyc_calloc = pool_hook_calloc;
+    lyc_realloc = pool_hook_realloc;
+    lyc_free = pool_hook_free;
+  });
+}
+} // size class pool allocator
+
+// fixed set of threads that split parallel_for jobs with the calling thread
+#define WORKER_POOL_MAX_THREADS 8
+
+struct WorkerPool {
+  pthread_t threads[WORKER_POOL_MAX_THREADS];
+  uint32 num_threads;
+  pthread_mutex_t mutex;
+  pthread_cond_t job_cond;
+  pthread_cond_t done_cond;
+  uint32 job_id; // bumped per job, every worker goes through every job
+  uint32 num_finished; // workers done with the current job
+  bool quit;
+  void (*job_func)(void *data, uint32 index);
+  void *job_data;
+  uint32 job_count;
+  _Atomic(uint32) job_next_index;
+};
+
+namespace { // worker pool
+void worker_pool_run_job(WorkerPool *pool) {
+  for (uint32 i = atomic_fetch_add(&pool->job_next_index, 1u); i < pool->job_count; i = atomic_fetch_add(&pool->job_next_index, 1u)) {
+    pool->job_func(pool->job_data, i);
+  }
+}
+
+void *worker_pool_thread_proc(void *user_data) {
+  WorkerPool *pool = (WorkerPool *)user_data;
+  uint32 job_id = 0;
+  pthread_mutex_lock(&pool->mutex);
+  for (;;) {
+    while (!pool->quit && pool->job_id == job_id) {
+      pthread_cond_wait(&pool->job_cond, &pool->mutex);
+    }
+    if (pool->quit) {
+      break;
+    }
+    job_id = pool->job_id;
+    pthread_mutex_unlock(&pool->mutex);
+    worker_pool_run_job(pool);
+    pthread_mutex_lock(&pool->mutex);
+    pool->num_finished += 1;
+    if (pool->num_finished == pool->num_threads) {
+      pthread_cond_signal(&pool->done_cond);
+    }
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  return nullptr;
+}
+
+// num_threads 0 picks one less than the number of cores, the caller is the last worker
+void init_worker_pool(WorkerPool *pool, uint32 num_threads = 0) {
+  pool->num_threads = 0;
+  pool->job_id = 0;
+  pool->num_finished = 0;
+  pool->quit = false;
+  atomic_store(&pool->job_next_index, 0u);
+  if (num_threads == 0) {
+    long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = num_cores > 1 ? (uint32)num_cores - 1 : 0;
+  }
+  num_threads = min(num_threads, (uint32)WORKER_POOL_MAX_THREADS);
+  pthread_mutex_init(&pool->mutex, nullptr);
+  pthread_cond_init(&pool->job_cond, nullptr);
+  pthread_cond_init(&pool->done_cond, nullptr);
+  for (uint32 i = 0; i < num_threads; ++i) {
+    if (pthread_create(&pool->threads[pool->num_threads], nullptr, worker_pool_thread_proc, pool)) {
+      LOGW("cannot create worker thread, pool has %u", pool->num_threads);
+      break;
+    }
+    pool->num_threads += 1;
+  }
+}
+
+void delete_worker_pool(WorkerPool *pool) {
+  pthread_mutex_lock(&pool->mutex);
+  pool->quit = true;
+  pthread_cond_broadcast(&pool->job_cond);
+  pthread_mutex_unlock(&pool->mutex);
+  for (uint32 i = 0; i < pool->num_threads; ++i) {
+    pthread_join(pool->threads[i], nullptr);
+  }
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_cond_destroy(&pool->job_cond);
+  pthread_mutex_destroy(&pool->mutex);
+  pool->num_threads = 0;
+}
+
+// calls func(data, i) for i in [0, count) across the pool and the calling thread, returns when all are done.
+// a null pool runs everything on the calling thread. jobs must not be started from inside a job
+void parallel_for(WorkerPool *pool, uint32 count, void (*func)(void *data, uint32 index), void *data) {
+  if (!pool || pool->num_threads == 0 || count < 2) {
+    for (uint32 i = 0; i < count; ++i) {
+      func(data, i);
+    }
+    return;
+  }
+  pthread_mutex_lock(&pool->mutex);
+  pool->job_func = func;
+  pool->job_data = data;
+  pool->job_count = count;
+  atomic_store(&pool->job_next_index, 0u);
+  pool->num_finished = 0;
+  pool->job_id += 1;
+  pthread_cond_broadcast(&pool->job_cond);
+  pthread_mutex_unlock(&pool->mutex);
+  worker_pool_run_job(pool);
+  pthread_mutex_lock(&pool->mutex);
+  while (pool->num_finished < pool->num_threads) {
+    pthread_cond_wait(&pool->done_cond, &pool->mutex);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
+} // worker pool
+
+struct FileMap { // read only view of a whole file, pages fault in on first touch instead of being copied up front
+  const byte *data;
+  uint32 len;
+  bool heap; // data is a MALLOC block instead, for buffers built in memory
+  #ifdef __ANDROID__
+  AAsset *asset; // AAsset_getBuffer memory lives as long as the asset stays open
+  #endif
+};
+
+namespace { // file map
+#ifdef __ANDROID__
+// uncompressed assets are mapped straight out of the apk, compressed ones get inflated into a buffer the asset owns
+bool map_asset(FileMap *map, AAssetManager *asset_manager, const char *path) {
+  *map = {};
+  AAsset *asset = AAssetManager_open(asset_manager, path, AASSET_MODE_BUFFER);
+  if (!asset) {
+    return false;
+  }
+  const void *data = AAsset_getBuffer(asset);
+  off_t len = AAsset_getLength(asset);
+  if (!data || len <= 0 || len > UINT32_MAX) {
+    AAsset_close(asset);
+    return false;
+  }
+  map->data = (const byte *)data;
+  map->len = (uint32)len;
+  map->asset = asset;
+  return true;
+}
+#else
+bool map_file(FileMap *map, const char *path) {
+  *map = {};
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  DEFER(close(fd));
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size <= 0 || st.st_size > UINT32_MAX) {
+    return false;
+  }
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0); // the mapping outlives fd
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  map->data = (const byte *)data;
+  map->len = (uint32)st.st_size;
+  return true;
+}
+#endif
+
+void unmap_file(FileMap *map) {
+  if (map->heap) {
+    FREE((void *)map->data);
+  }
+  #ifdef __ANDROID__
+  else if (map->asset) {
+    AAsset_close(map->asset);
+  }
+  #else
+  else if (map->data) {
+    munmap((void *)map->data, map->len);
+  }
+  #endif
+  *map = {};
+}
+} // file map
+
+struct TextVertex { // 12 bytes, a quad is 4 of them drawn through the shared quad index buf
+  int16 x, y; // in 1/TEXT_VERTEX_SUBPIXELS pixels, the projection scales them back
+  uint16 s, t; // unorm16
+  uint8 r, g, b, a;
+};
+
+struct GlyphInstance { // 12 bytes, one per drawn glyph, the glyphs vertex shader expands it into the glyph's quad
+  int16 x, y; // pen position, in 1/TEXT_VERTEX_SUBPIXELS pixels like TextVertex
+  uint16 slot; // glyph table entry
+  uint16 scale; // draw size over raster size, 8.8 fixed point
+  uint8 r, g, b, a;
+};
+
+#define TEXT_VERTEX_SUBPIXELS 4
+#define GLYPH_INSTANCE_SCALE_ONE 256
+#define TEXT_INSTANCE_CHUNK_INSTANCES 4096 // 48KB gl buffers, growing adds one and never copies the others
+#define QUAD_INDEX_BUF_QUADS 16384 // uint16 indices reach 4 verts of each, draws longer than that go in batches
+
+namespace { // text vertex
+int16 text_vertex_coord(float pixels) {
+  float v = roundf(pixels * TEXT_VERTEX_SUBPIXELS);
+  return (int16)max(-32768.0f, min(v, 32767.0f)); // far off screen either way, a degenerate quad is fine
+}
+
+uint16 text_vertex_tcoord(float tcoord) {
+  return (uint16)roundf(max(0.0f, min(tcoord, 1.0f)) * 65535.0f);
+}
+
+// corners in pixels, (x0, y0) gets (s0, t0). verts gets the 4 of them in quad index buf order
+void put_text_quad(TextVertex *verts, float x0, float y0, float x1, float y1, float s0, float t0, float s1, float t1, uint32 rgba) {
+  int16 xs[2] = {text_vertex_coord(x0), text_vertex_coord(x1)};
+  int16 ys[2] = {text_vertex_coord(y0), text_vertex_coord(y1)};
+  uint16 ss[2] = {text_vertex_tcoord(s0), text_vertex_tcoord(s1)};
+  uint16 ts[2] = {text_vertex_tcoord(t0), text_vertex_tcoord(t1)};
+  for (int i = 0; i < 4; ++i) {
+    TextVertex *v = &verts[i];
+    v->x = xs[i & 1];
+    v->y = ys[i >> 1];
+    v->s = ss[i & 1];
+    v->t = ts[i >> 1];
+    v->r = (uint8)(rgba >> 24);
+    v->g = (uint8)(rgba >> 16);
+    v->b = (uint8)(rgba >> 8);
+    v->a = (uint8)rgba;
+  }
+}
+} // text vertex
+
+#define TEXT_LAYOUT_LINE_SPARE_SLOTS 16 // lines get up to this many empty instances to grow into
+#define TEXT_LAYOUT_PAGE_LINES 64 // instance y is relative to the top of its line's page, tall fonts get fewer lines a page
+#define TEXT_LAYOUT_PREFETCH_BYTES 4096 // text is read ahead this far for glyphs to rasterize in a batch
+
+struct TextLayout { // a block of utf-8 text broken into lines of glyph instances, see layout_text
+  struct Line {
+    uint32 begin; // byte offset in the text
+    uint32 end; // byte offset of the next line, past the newline or the spaces the line wrapped at
+    uint32 first_instance;
+    uint32 num_instances; // glyphs, the rest of the slots up to the next line hold empty instances
+    uint32 num_instance_slots; // room for the line to grow in place when it is edited
+    float width; // pixels, trailing spaces left out
+  };
+  uint32 font; // font id
+  float x, y; // top left of the block, pixels
+  float max_width; // lines wrap at spaces to stay within it, 0 for no wrapping
+  uint32 rgba; // of every glyph
+  uint32 line_limit; // layout stops at this many lines and leaves the rest of the text for later, 0 for no limit
+  bool truncated; // the text goes on past the last line
+  Line *lines;
+  GlyphInstance *instances;
+  Line *staged_lines; // relayout_text lays lines out here first, kept between edits for the capacity
+  GlyphInstance *staged_instances;
+  uint32 font_atlas_generation; // of the glyphs the instances reference
+};
+
+struct TextLabel { // retained text for ui, laid out and uploaded when its text or style changes only, see set_text_label
+  uint64 key; // hash of the text and the style, see hash_text_label
+  char *text; // kept to lay it out again after glyphs leave the atlas
+  TextLayout layout; // font, max_width and rgba are the style. at 0, 0, the label is placed when drawn
+  GLuint *gl_instance_chunks; // like OnScreenText's
+};
+
+struct Program { // root data structure of the entire program
+  #ifdef __ANDROID__
+  android_app* app;
+  #endif
+  Arena scratch_arena; // for transient work on the gl thread, through ARENA_SCOPE and ARENA_ALLOC
+  WorkerPool worker_pool;
+  struct OpenGLES {
+    #ifdef __ANDROID__
+    EGLDisplay display;
+    EGLConfig display_config;
+    EGLSurface surface;
+    EGLContext context;
+    #endif
+    int surface_width;
+    int surface_height;
+    GLuint quad_index_buf_id; // 0,1,2, 2,1,3 for QUAD_INDEX_BUF_QUADS quads of 4 verts
+    struct Shaders {
+      struct Text {
+        GLuint id;
+        GLint uniform_mvp_mat;
+        GLint uniform_tex;
+        GLuint attrib_position;
+        GLuint attrib_color;
+        GLuint attrib_tcoord;
+      } text;
+      struct Glyphs { // instanced, GlyphInstance attributes
+        GLuint id;
+        GLint uniform_mvp_mat;
+        GLint uniform_tex;
+        GLint uniform_glyph_table;
+        GLint uniform_atlas_size;
+        GLint uniform_pen_units_per_pixel;
+        GLint uniform_origin; // pen units, added to every pen position
+        GLint uniform_smoothing; // sdf only, half a screen pixel in distance field units
+        GLuint attrib_pen;
+        GLuint attrib_slot_scale;
+        GLuint attrib_color;
+      } glyphs, glyphs_sdf;
+    } shaders;
+  } opengl_es;
+  struct Fonts { // every face and size shares one atlas texture, so all text draws with a single bind
+    struct GlyphMetrics {
+      int glyph_index;
+      int advance; // font units
+    };
+    struct Face {
+      FileMap font_file; // owned, stbtt_fontinfo points into it
+      stbtt_fontinfo info;
+      int ascent, descent, line_gap; // font units
+      HashMap<uint32, GlyphMetrics> glyph_metrics; // keyed by codepoint, filled in as codepoints get laid out
+      HashMap<uint32, int16> kern_advances; // keyed by glyph index pair, font units. stbtt binary searches the kern table
+      uint32 *ligature_subtables; // font file offsets of the gsub 'liga' ligature substitution subtables, in lookup order
+      int x_height; // font units, combining marks above taller glyphs are raised by the difference
+    };
+    struct Font {
+      uint32 face;
+      float size; // pixel height text is drawn at
+      float raster_size; // pixel height glyphs are rasterized at, same as size unless sdf
+      float scale_factor; // font units to pixels at size
+      float ascent; // pixels at size, baseline below the top of a line
+      float line_height; // pixels at size, ascent - descent + line gap
+      uint32 page_lines; // lines in a layout page, as many as keep page relative quarter pixel y within int16
+      uint32 raster_id; // fonts with the same raster id share glyphs
+    };
+    struct Glyph {
+      stbtt_packedchar packed_char;
+      uint32 last_use;
+      uint32 font; // any font with the glyph's raster id, to rasterize it again after eviction
+      uint32 slot; // glyph table entry
+    };
+    struct ShapedGlyph {
+      uint32 codepoint; // of the glyph in the atlas, past U+10FFFF for ligatures, see FONT_GLYPH_INDEX_CODEPOINTS
+      int glyph_index;
+      uint32 cluster; // byte offset in the run of the first char the glyph stands for, marks share their base's
+      float x, y; // pen position relative to the start of the run, pixels, y down
+      float advance; // pixels, 0 for combining marks
+    };
+    struct ShapedRun { // see shape_text_run
+      uint32 font;
+      char *text; // array, the key is only a hash of it and the font
+      ShapedGlyph *glyphs;
+      float width; // pixels, kerning included
+      uint32 last_use;
+    };
+    struct GlyphTableEntry { // all the text vertex shader knows of a glyph, two RGBA32F texels
+      float xoff, yoff, xoff2, yoff2; // quad corners relative to the pen, raster pixels
+      float x0, y0, x1, y1; // atlas rect, texels
+    };
+    Face *faces;
+    Font *fonts; // indexed by font id
+    HashMap<uint32, Glyph> glyphs; // keyed by glyph id, only glyphs drawn since the last eviction
+    bool sdf; // atlas holds signed distance fields at FONT_SDF_RASTER_SIZE, quads scale them to any size
+    stbtt_pack_context pack_context; // no pixels, glyphs are rasterized one by one and uploaded with glTexSubImage2D
+    WorkerPool *worker_pool; // optional, rasterizes batches of glyphs in parallel
+    FileMap baked_atlas; // owned, see baked_font_atlas.h. its glyphs are put back at the top of the atlas on every reset
+    uint32 baked_atlas_font;
+    uint32 use_clock;
+    uint32 atlas_generation; // bumped whenever cached glyphs leave the atlas, quads built before are stale
+    int atlas_w;
+    int atlas_h; // power of two, grows up to atlas_max_h before anything gets evicted
+    int atlas_max_h;
+    bool atlas_mipmaps;
+    bool atlas_mipmaps_dirty; // glyphs went in since the mip chain was last generated
+    GLuint atlas_gl_texture_id; // GL_R8
+    GlyphTableEntry *glyph_table; // FONT_GLYPH_TABLE_SLOTS entries, slots are handed out in order until the next reset
+    uint32 num_glyph_slots;
+    uint32 num_glyph_slots_uploaded;
+    GLuint glyph_table_gl_texture_id; // RGBA32F, FONT_GLYPH_TABLE_ROW_SLOTS entries per row
+    HashMap<uint64, ShapedRun> shaped_runs; // keyed by hash_text_run, up to FONT_SHAPED_RUN_CACHE_SIZE
+    uint32 shape_clock;
+  } fonts;
+  struct FontLoad { // reads the on screen text font and its baked ascii off the gl thread, see start_font_load
+    _Atomic(int) status; // 0:not started, 1:start failed, 2:in progress, 3:succeed, 4:failed
+    const char *ttf_path;
+    const char *baked_atlas_path; // optional, baked in memory when missing or stale
+    float size;
+    bool sdf;
+    bool (*map_file)(FontLoad *load, const char *path, FileMap *map); // platform, called on the load thread
+    void (*done)(FontLoad *load); // platform, called on the load thread, hands the load over to the gl thread
+    void *platform_data;
+    int write_pipe; // android, done writes the load pointer to it
+    FileMap ttf;
+    FileMap baked_atlas;
+  } font_load;
+  struct KeyboardState {
+    bool shift_on;
+  } keyboard_state;
+  struct OnScreenText{
+    char *text;
+    TextLayout layout; // its instances are the staging copy of the gl buf
+    GLuint *gl_instance_chunks; // buffer ids, each holds TEXT_INSTANCE_CHUNK_INSTANCES of the layout's instances
+    uint32 num_instances_uploaded;
+    float scroll_y; // pixels of the layout above the top of the surface
+  } on_screen_text;
+  TextLabel status_label; // size and scroll position of the on screen text, drawn over it by the platform
+  struct Network {
+    int dns_lookup_pipe[2];
+    struct DNSLookup {
+      _Atomic(int) status; // 0:not started, 2:in progress, 3:succeed, 4:failed
+      int write_pipe;
+      const char *domain_name;
+      const char *service;
+      addrinfo request;
+      addrinfo *response;
+      DNSLookup *next; // the rest of the batch passed to dns_lookup
+    };
+    HashMap<const char *, DNSLookup *> dns_lookups; // in flight, keyed by domain name
+    struct ConnectionAttempt {
+      int socket_fd;
+      const char *domain_name;
+      addrinfo *addr_list;
+      addrinfo *cur_addr;
+    };
+    HashMap<int, ConnectionAttempt> connection_attempts; // connects in progress, keyed by socket_fd
+    struct Connection {
+      int socket_fd;
+      const char *domain_name;
+    };
+    HashMap<int, Connection> connections; // keyed by socket_fd
+  } network;
+};
+
+void gl_swap_buffers(Program::OpenGLES *opengl_es) {
+  #if defined(__APPLE__)
+  [[EAGLContext currentContext] presentRenderbuffer:GL_RENDERBUFFER];
+  #elif defined(__ANDROID__)
+  eglSwapBuffers(opengl_es->display, opengl_es->surface);
+  #else
+  (void)opengl_es; // host side, nothing to present to
+  #endif
+}
+
+// called once per gl context, every quad batch draws through it
+void init_opengl_es_quad_index_buf(Program::OpenGLES *opengl_es) {
+  uint16 *indices = MALLOC(uint16, QUAD_INDEX_BUF_QUADS * 6);
+  DEFER(FREE(indices));
+  for (uint32 i = 0; i < QUAD_INDEX_BUF_QUADS; ++i) {
+    uint16 v = (uint16)(i * 4);
+    uint16 quad[] = {v, (uint16)(v + 1), (uint16)(v + 2), (uint16)(v + 2), (uint16)(v + 1), (uint16)(v + 3)};
+    memcpy(&indices[i * 6], quad, sizeof(quad));
+  }
+  glGenBuffers(1, &opengl_es->quad_index_buf_id);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, opengl_es->quad_index_buf_id);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, QUAD_INDEX_BUF_QUADS * 6 * sizeof(uint16), indices, GL_STATIC_DRAW);
+}
+
+// binds the text attributes of verts_buf and draws num_quads quads of it, in batches the quad index buf can address
+void draw_text_quads(Program::OpenGLES *opengl_es, Program::OpenGLES::Shaders::Text *shader, GLuint verts_buf, uint32 num_quads) {
+  glBindBuffer(GL_ARRAY_BUFFER, verts_buf);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, opengl_es->quad_index_buf_id);
+  glEnableVertexAttribArray(shader->attrib_position);
+  glEnableVertexAttribArray(shader->attrib_color);
+  glEnableVertexAttribArray(shader->attrib_tcoord);
+  for (uint32 first = 0; first < num_quads; first += QUAD_INDEX_BUF_QUADS) {
+    uintptr_t offset = first * 4 * sizeof(TextVertex);
+    glVertexAttribPointer(shader->attrib_position, 2, GL_SHORT, GL_FALSE, sizeof(TextVertex), (void *)(offset + offsetof(TextVertex, x)));
+    glVertexAttribPointer(shader->attrib_tcoord, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(TextVertex), (void *)(offset + offsetof(TextVertex, s)));
+    glVertexAttribPointer(shader->attrib_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex), (void *)(offset + offsetof(TextVertex, r)));
+    glDrawElements(GL_TRIANGLES, min(num_quads - first, (uint32)QUAD_INDEX_BUF_QUADS) * 6, GL_UNSIGNED_SHORT, nullptr);
+  }
+  glDisableVertexAttribArray(shader->attrib_position);
+  glDisableVertexAttribArray(shader->attrib_color);
+  glDisableVertexAttribArray(shader->attrib_tcoord);
+}
+
+void init_opengl_es_shaders(Program::OpenGLES::Shaders *shaders, Arena *scratch_arena) {
+  struct ProgramSrc {
+    const char *vert_shader;
+    int vert_shader_len;
+    const char *frag_shader;
+    int frag_shader_len;
+  };
+  auto split_src_string = [](const char *src) -> ProgramSrc {
+    #define VS_STAGE_STR "[Vertex Shader Stage]"
+    #define FS_STAGE_STR "[Fragment Shader Stage]"
+    ProgramSrc psrc = {};
+    const char *vsi_pos = strstr(src, VS_STAGE_STR);
+    const char *fsi_pos = strstr(src, FS_STAGE_STR);
+    if (vsi_pos && fsi_pos) {
+      psrc.vert_shader = vsi_pos + strlen(VS_STAGE_STR);
+      psrc.vert_shader_len = fsi_pos - psrc.vert_shader;
+      psrc.frag_shader = fsi_pos + strlen(FS_STAGE_STR);
+      psrc.frag_shader_len = strlen(src) - (psrc.frag_shader - src);
+    }
+    return psrc;
+  };
+  auto compile_shader = [scratch_arena](const char* shader_name, const char *src, int src_len, GLenum shader_type) -> GLuint {
+    GLuint shader_id = glCreateShader(shader_type);
+    if (shader_id == 0) {
+      return 0;
+    }
+    glShaderSource(shader_id, 1, &src, &src_len);
+    glCompileShader(shader_id);
+    GLint logLength;
+    glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &logLength);
+    if (logLength > 0) {
+      ARENA_SCOPE(scratch_arena);
+      GLchar *log = ARENA_ALLOC(scratch_arena, GLchar, logLength);
+      if (log) {
+        glGetShaderInfoLog(shader_id, logLength, &logLength, log);
+        if (strcmp(log, "")) {
+          LOGI("shader \"%s\" compile message:\n%s\n", shader_name, log);
+        }
+      } else {
+        LOGW("shader \"%s\" compile message of %d bytes does not fit in the scratch arena", shader_name, logLength);
+      }
+    }
+    GLint status;
+    glGetShaderiv(shader_id, GL_COMPILE_STATUS, &status);
+    if (status == GL_FALSE) {
+      glDeleteShader(shader_id);
+      return 0;
+    }
+    return shader_id;
+  };
+  auto link_shader = [scratch_arena](const char* shader_name, GLuint vs_id, GLuint fs_id) -> GLuint {
+    GLuint shader_id = glCreateProgram();
+    if (!shader_id) {
+      return 0;
+    }
+    glAttachShader(shader_id, vs_id);
     glAttachShader(shader_id, fs_id);
     glLinkProgram(shader_id);
     GLint logLength;
     glGetProgramiv(shader_id, GL_INFO_LOG_LENGTH, &logLength);
     if (logLength > 0) {
-      GLchar *log = MALLOC(GLchar, logLength);
-      DEFER(FREE(log));
-      glGetProgramInfoLog(shader_id, logLength, &logLength, log);
-      if (strcmp(log, "")) {
-        LOGI("shader \"%s\" link message:\n%s\n", shader_name, log);
+      ARENA_SCOPE(scratch_arena);
+      GLchar *log = ARENA_ALLOC(scratch_arena, GLchar, logLength);
+      if (log) {
+        glGetProgramInfoLog(shader_id, logLength, &logLength, log);
+        if (strcmp(log, "")) {
+          LOGI("shader \"%s\" link message:\n%s\n", shader_name, log);
+        }
+      } else {
+        LOGW("shader \"%s\" link message of %d bytes does not fit in the scratch arena", shader_name, logLength);
+      }
+    }
+    GLint status;
+    glGetProgramiv(shader_id, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) {
+      glDeleteProgram(shader_id);
+      glDeleteShader(vs_id);
+      glDeleteShader(fs_id);
+      return 0;
+    }
+    glDetachShader(shader_id, vs_id);
+    glDetachShader(shader_id, fs_id);
+    glDeleteShader(vs_id);
+    glDeleteShader(fs_id);
+    return shader_id;
+  };
+  auto create_shader = [&](const char* shader_name, const char *src) -> GLuint {
+    ProgramSrc psrc = split_src_string(src);
+    GLuint vs_id = compile_shader(shader_name, psrc.vert_shader, psrc.vert_shader_len, GL_VERTEX_SHADER);
+    GLuint fs_id = compile_shader(shader_name, psrc.frag_shader, psrc.frag_shader_len, GL_FRAGMENT_SHADER);
+    GLuint shader_id = link_shader(shader_name, vs_id, fs_id);
+    return shader_id;
+  };
+  { // text shader
+    const char *src = R"(
+      [Vertex Shader Stage]
+      uniform mat4 mvp_mat;
+      attribute vec2 position;
+      attribute vec4 color;
+      attribute vec2 tcoord;
+      varying vec4 color_vs;
+      varying vec2 tcoord_vs;
+      void main() {
+        color_vs = color;
+        tcoord_vs = tcoord;
+        gl_Position = mvp_mat * vec4(position, 0.0, 1.0);
+      }
+      [Fragment Shader Stage]
+      uniform sampler2D tex;
+      varying mediump vec4 color_vs;
+      varying mediump vec2 tcoord_vs;
+      void main() {
+        gl_FragColor.rgb = color_vs.rgb;
+        gl_FragColor.a = texture2D(tex, tcoord_vs).r;
+      }
+    )";
+    auto *shader = &shaders->text;
+    shader->id = create_shader("simple_texture", src);;
+    shader->uniform_mvp_mat = glGetUniformLocation(shader->id, "mvp_mat");
+    shader->uniform_tex = glGetUniformLocation(shader->id, "tex");
+    shader->attrib_position = glGetAttribLocation(shader->id, "position");
+    shader->attrib_color = glGetAttribLocation(shader->id, "color");
+    shader->attrib_tcoord = glGetAttribLocation(shader->id, "tcoord");
+    LOGI("loaded \"simple texture\" shader(id:%d)", shader->id);
+  }
+  { // glyph instance shaders, each instance is one glyph drawn as a 4 vertex triangle strip. the quad comes from the
+    // glyph table, two texels per slot: corners relative to the pen in raster pixels, then the atlas rect in texels.
+    // glsl es 3.00 for gl_VertexID and texelFetch. the vertex stage is shared, so the stages are compiled one by one
+    const char *vert_src = R"(#version 300 es
+      uniform mat4 mvp_mat;
+      uniform highp sampler2D glyph_table;
+      uniform vec2 atlas_size;
+      uniform float pen_units_per_pixel;
+      uniform vec2 origin;
+      in vec2 pen;
+      in vec2 slot_scale;
+      in vec4 color;
+      out vec4 color_vs;
+      out vec2 tcoord_vs;
+      void main() {
+        int row_slots = textureSize(glyph_table, 0).x / 2;
+        int slot = int(slot_scale.x);
+        ivec2 texel = ivec2(slot % row_slots * 2, slot / row_slots);
+        vec4 corners = texelFetch(glyph_table, texel, 0);
+        vec4 rect = texelFetch(glyph_table, texel + ivec2(1, 0), 0);
+        vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+        vec2 position = origin + pen + mix(corners.xy, corners.zw, corner) * (slot_scale.y / 256.0 * pen_units_per_pixel);
+        color_vs = color;
+        tcoord_vs = mix(rect.xy, rect.zw, corner) / atlas_size;
+        gl_Position = mvp_mat * vec4(position, 0.0, 1.0);
+      }
+    )";
+    const char *frag_src = R"(#version 300 es
+      precision mediump float;
+      uniform sampler2D tex;
+      in vec4 color_vs;
+      in vec2 tcoord_vs;
+      out vec4 frag_color;
+      void main() {
+        frag_color.rgb = color_vs.rgb;
+        frag_color.a = texture(tex, tcoord_vs).r;
+      }
+    )";
+    const char *sdf_frag_src = R"(#version 300 es
+      precision mediump float;
+      uniform sampler2D tex;
+      uniform float smoothing;
+      in vec4 color_vs;
+      in vec2 tcoord_vs;
+      out vec4 frag_color;
+      void main() {
+        const float onedge = 128.0 / 255.0;
+        float dist = texture(tex, tcoord_vs).r;
+        frag_color.rgb = color_vs.rgb;
+        frag_color.a = smoothstep(onedge - smoothing, onedge + smoothing, dist);
+      }
+    )";
+    auto load_glyphs_shader = [&](Program::OpenGLES::Shaders::Glyphs *shader, const char *name, const char *frag_src) {
+      GLuint vs_id = compile_shader(name, vert_src, (int)strlen(vert_src), GL_VERTEX_SHADER);
+      GLuint fs_id = compile_shader(name, frag_src, (int)strlen(frag_src), GL_FRAGMENT_SHADER);
+      shader->id = link_shader(name, vs_id, fs_id);
+      shader->uniform_mvp_mat = glGetUniformLocation(shader->id, "mvp_mat");
+      shader->uniform_tex = glGetUniformLocation(shader->id, "tex");
+      shader->uniform_glyph_table = glGetUniformLocation(shader->id, "glyph_table");
+      shader->uniform_atlas_size = glGetUniformLocation(shader->id, "atlas_size");
+      shader->uniform_pen_units_per_pixel = glGetUniformLocation(shader->id, "pen_units_per_pixel");
+      shader->uniform_origin = glGetUniformLocation(shader->id, "origin");
+      shader->uniform_smoothing = glGetUniformLocation(shader->id, "smoothing");
+      shader->attrib_pen = glGetAttribLocation(shader->id, "pen");
+      shader->attrib_slot_scale = glGetAttribLocation(shader->id, "slot_scale");
+      shader->attrib_color = glGetAttribLocation(shader->id, "color");
+      LOGI("loaded \"%s\" shader(id:%d)", name, shader->id);
+    };
+    load_glyphs_shader(&shaders->glyphs, "glyphs", frag_src);
+    load_glyphs_shader(&shaders->glyphs_sdf, "sdf glyphs", sdf_frag_src);
+  }
+}
+
+#define FONT_ATLAS_SIZE 1024 // width, and the height the atlas may grow to
+#define FONT_SDF_ATLAS_SIZE 512
+#define FONT_ATLAS_MIN_HEIGHT 64
+#define FONT_ATLAS_PADDING 1
+#define FONT_SDF_RASTER_SIZE 32
+#define FONT_SDF_SPREAD 4 // pixels of distance either side of the outline, at raster size
+#define FONT_GLYPH_CODEPOINT_BITS 21 // enough for U+10FFFF, the raster id takes the rest of a glyph id
+#define FONT_GLYPH_INDEX_CODEPOINTS 0x110000 // past unicode, codepoint 0x110000 + i is glyph index i. for glyphs no codepoint maps to, like ligatures
+#define FONT_GLYPH_TABLE_SLOTS 4096
+#define FONT_GLYPH_TABLE_ROW_SLOTS 64
+#define FONT_SHAPED_RUN_CACHE_SIZE 4096 // runs, the least recently used half goes when it fills up
+#define FONT_SHAPED_RUN_MAX_BYTES 64 // text runs are words, longer ones get shaped in pieces
+
+// returns U+FFFD for malformed input, always advances at least one byte. each maximal subpart of an ill-formed
+// sequence becomes one U+FFFD, as unicode recommends: overlongs, surrogates and anything past U+10FFFF are cut off
+// at the second byte by narrowing its range
+uint32 utf8_decode(const char **str, const char *end) {
+  const uchar *s = (const uchar *)*str;
+  uint32 c = s[0];
+  if (c < 0x80) {
+    *str += 1;
+    return c;
+  }
+  uint32 len;
+  uchar lo = 0x80; // range of the second byte
+  uchar hi = 0xbf;
+  if (c >= 0xc2 && c <= 0xdf) {
+    len = 2, c &= 0x1f;
+  } else if (c >= 0xe0 && c <= 0xef) {
+    len = 3, c &= 0x0f;
+    lo = c == 0x0 ? 0xa0 : lo;
+    hi = c == 0xd ? 0x9f : hi;
+  } else if (c >= 0xf0 && c <= 0xf4) {
+    len = 4, c &= 0x07;
+    lo = c == 0x0 ? 0x90 : lo;
+    hi = c == 0x4 ? 0x8f : hi;
+  } else {
+    *str += 1;
+    return 0xfffd;
+  }
+  uint32 avail = (uint32)(end - *str);
+  for (uint32 i = 1; i < len; ++i) {
+    if (i >= avail || s[i] < lo || s[i] > hi) {
+      *str += i;
+      return 0xfffd;
+    }
+    c = (c << 6) | (s[i] & 0x3f);
+    lo = 0x80;
+    hi = 0xbf;
+  }
+  *str += len;
+  return c;
+}
+
+// appends the codepoints of [str, end). all ascii blocks of 16 bytes are widened at once where there is simd, the
+// rest goes through utf8_decode. a block that is not all ascii is decoded to its end before simd is tried again, so
+// non latin text does not pay for a failed block test per char
+void utf8_decode_to_array(const char *str, const char *end, uint32 **codepoints) {
+  uint32 size = array_size(*codepoints);
+  array_resize(codepoints, size + (uint32)(end - str)); // never more codepoints than bytes
+  uint32 *dst = *codepoints + size;
+  const char *block_end = str;
+  while (str < end) {
+    #if defined(__SSE2__)
+    if (str >= block_end && end - str >= 16) {
+      __m128i bytes = _mm_loadu_si128((const __m128i *)str);
+      if (!_mm_movemask_epi8(bytes)) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(lo, zero));
+        _mm_storeu_si128((__m128i *)dst + 1, _mm_unpackhi_epi16(lo, zero));
+        _mm_storeu_si128((__m128i *)dst + 2, _mm_unpacklo_epi16(hi, zero));
+        _mm_storeu_si128((__m128i *)dst + 3, _mm_unpackhi_epi16(hi, zero));
+        str += 16;
+        dst += 16;
+        continue;
+      }
+      block_end = str + 16;
+    }
+    #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    if (str >= block_end && end - str >= 16) {
+      uint8x16_t bytes = vld1q_u8((const uint8 *)str);
+      if (!hash_map_neon_mask(vcltq_s8(vreinterpretq_s8_u8(bytes), vdupq_n_s8(0)))) {
+        uint16x8_t lo = vmovl_u8(vget_low_u8(bytes));
+        uint16x8_t hi = vmovl_u8(vget_high_u8(bytes));
+        vst1q_u32(dst, vmovl_u16(vget_low_u16(lo)));
+        vst1q_u32(dst + 4, vmovl_u16(vget_high_u16(lo)));
+        vst1q_u32(dst + 8, vmovl_u16(vget_low_u16(hi)));
+        vst1q_u32(dst + 12, vmovl_u16(vget_high_u16(hi)));
+        str += 16;
+        dst += 16;
+        continue;
+      }
+      block_end = str + 16;
+    }
+    #endif
+    *dst++ = (uchar)*str < 0x80 ? (uchar)*str++ : utf8_decode(&str, end);
+  }
+  array_resize(codepoints, (uint32)(dst - *codepoints));
+}
+
+void delete_fonts(Program::Fonts *fonts) {
+  if (fonts->atlas_gl_texture_id) {
+    glDeleteTextures(1, &fonts->atlas_gl_texture_id); // no-op if the context is already gone
+  }
+  if (fonts->pack_context.pack_info) {
+    stbtt_PackEnd(&fonts->pack_context);
+  }
+  if (fonts->glyph_table_gl_texture_id) {
+    glDeleteTextures(1, &fonts->glyph_table_gl_texture_id);
+  }
+  delete_hash_map(&fonts->glyphs);
+  FREE(fonts->glyph_table);
+  unmap_file(&fonts->baked_atlas);
+  for (uint32 i = 0; i < array_size(fonts->faces); ++i) {
+    unmap_file(&fonts->faces[i].font_file);
+    delete_hash_map(&fonts->faces[i].glyph_metrics);
+    delete_hash_map(&fonts->faces[i].kern_advances);
+    delete_array(fonts->faces[i].ligature_subtables);
+  }
+  hash_map_for_each(&fonts->shaped_runs, [](uint64, Program::Fonts::ShapedRun *run) {
+    delete_array(run->text);
+    delete_array(run->glyphs);
+  });
+  delete_hash_map(&fonts->shaped_runs);
+  delete_array(fonts->faces);
+  delete_array(fonts->fonts);
+  *fonts = {};
+}
+
+// mipmaps keep minified text from aliasing, at the cost of a glGenerateMipmap after each batch of new glyphs
+bool init_fonts(Program::Fonts *fonts, bool sdf = false, bool mipmaps = false) {
+  *fonts = {};
+  fonts->sdf = sdf;
+  fonts->atlas_w = sdf ? FONT_SDF_ATLAS_SIZE : FONT_ATLAS_SIZE;
+  fonts->atlas_h = FONT_ATLAS_MIN_HEIGHT;
+  fonts->atlas_max_h = fonts->atlas_w;
+  fonts->atlas_mipmaps = mipmaps;
+  if (!stbtt_PackBegin(&fonts->pack_context, nullptr, fonts->atlas_w, fonts->atlas_h, 0, FONT_ATLAS_PADDING, nullptr)) {
+    LOGF("stb_truetype PackBegin error");
+    *fonts = {};
+    return false;
+  }
+  if (!sdf) { // the distance field interpolates well enough on its own
+    stbtt_PackSetOversampling(&fonts->pack_context, 2, 2);
+  }
+  fonts->glyph_table = CALLOC(Program::Fonts::GlyphTableEntry, FONT_GLYPH_TABLE_SLOTS);
+  return true;
+}
+
+// stb_truetype reads no gsub, this finds the ligature substitutions of its 'liga' feature. every script and language
+// gets the same ones, which is all the latin fonts here need
+void find_font_ligature_subtables(Program::Fonts::Face *face) {
+  const stbtt_uint8 *data = face->info.data;
+  uint32 gsub = stbtt__find_table(face->info.data, face->info.fontstart, "GSUB");
+  if (!gsub) {
+    return;
+  }
+  const stbtt_uint8 *features = data + gsub + ttUSHORT(data + gsub + 6);
+  const stbtt_uint8 *lookups = data + gsub + ttUSHORT(data + gsub + 8);
+  uint32 num_lookups = ttUSHORT(lookups);
+  bool *liga_lookups = CALLOC(bool, max(num_lookups, 1u));
+  DEFER(FREE(liga_lookups));
+  for (uint32 i = 0; i < ttUSHORT(features); ++i) {
+    const stbtt_uint8 *record = features + 2 + 6 * i;
+    if (!memcmp(record, "liga", 4)) {
+      const stbtt_uint8 *feature = features + ttUSHORT(record + 4);
+      for (uint32 j = 0; j < ttUSHORT(feature + 2); ++j) {
+        uint32 lookup_index = ttUSHORT(feature + 4 + 2 * j);
+        if (lookup_index < num_lookups) {
+          liga_lookups[lookup_index] = true;
+        }
+      }
+    }
+  }
+  for (uint32 i = 0; i < num_lookups; ++i) {
+    if (!liga_lookups[i]) {
+      continue;
+    }
+    const stbtt_uint8 *lookup = lookups + ttUSHORT(lookups + 2 + 2 * i);
+    for (uint32 j = 0; j < ttUSHORT(lookup + 4); ++j) {
+      const stbtt_uint8 *subtable = lookup + ttUSHORT(lookup + 6 + 2 * j);
+      uint32 type = ttUSHORT(lookup);
+      if (type == 7) { // extension, the real subtable is a 32 bit offset away
+        type = ttUSHORT(subtable + 2);
+        subtable += ttULONG(subtable + 4);
+      }
+      if (type == 4 && ttUSHORT(subtable) == 1) {
+        array_push(&face->ligature_subtables, (uint32)(subtable - data));
+      }
+    }
+  }
+}
+
+// takes ownership of font_file, even on failure. returns the face id or -1
+int add_font_face(Program::Fonts *fonts, FileMap *font_file) {
+  Program::Fonts::Face face = {};
+  face.font_file = *font_file;
+  *font_file = {};
+  if (!stbtt_InitFont(&face.info, face.font_file.data, 0)) {
+    LOGF("cannot init font info from font file");
+    unmap_file(&face.font_file);
+    return -1;
+  }
+  stbtt_GetFontVMetrics(&face.info, &face.ascent, &face.descent, &face.line_gap);
+  int x0, y0, x1;
+  if (!stbtt_GetGlyphBox(&face.info, stbtt_FindGlyphIndex(&face.info, 'x'), &x0, &y0, &x1, &face.x_height)) {
+    face.x_height = face.ascent / 2;
+  }
+  find_font_ligature_subtables(&face);
+  array_push(&fonts->faces, face);
+  return (int)array_size(fonts->faces) - 1;
+}
+
+// returns the font id, no glyph is rasterized until it is first drawn
+uint32 add_font(Program::Fonts *fonts, uint32 face, float size) {
+  assert(face < array_size(fonts->faces));
+  uint32 num_fonts = array_size(fonts->fonts);
+  for (uint32 i = 0; i < num_fonts; ++i) {
+    if (fonts->fonts[i].face == face && fonts->fonts[i].size == size) {
+      return i;
+    }
+  }
+  Program::Fonts::Font font = {};
+  font.face = face;
+  font.size = size;
+  font.raster_size = fonts->sdf ? FONT_SDF_RASTER_SIZE : size;
+  font.scale_factor = stbtt_ScaleForPixelHeight(&fonts->faces[face].info, size);
+  auto *f = &fonts->faces[face];
+  font.ascent = f->ascent * font.scale_factor;
+  font.line_height = (f->ascent - f->descent + f->line_gap) * font.scale_factor;
+  // the last line's baseline plus a line of room for marks above and below it
+  float page_height = 32767.0f / TEXT_VERTEX_SUBPIXELS - font.ascent - font.line_height;
+  font.page_lines = (uint32)max(1.0f, min(floorf(page_height / font.line_height) + 1, (float)TEXT_LAYOUT_PAGE_LINES));
+  assert((font.ascent + font.line_height * font.page_lines) * TEXT_VERTEX_SUBPIXELS <= 32767.0f);
+  font.raster_id = fonts->sdf ? face : num_fonts; // distance fields of a face serve every size
+  assert(font.raster_id < (1u << (32 - FONT_GLYPH_CODEPOINT_BITS)));
+  array_push(&fonts->fonts, font);
+  return num_fonts;
+}
+
+uint32 font_glyph_id(Program::Fonts *fonts, uint32 font, uint32 codepoint) {
+  assert(codepoint < (1u << FONT_GLYPH_CODEPOINT_BITS));
+  return fonts->fonts[font].raster_id << FONT_GLYPH_CODEPOINT_BITS | codepoint;
+}
+
+int font_codepoint_glyph_index(stbtt_fontinfo *info, uint32 codepoint) {
+  if (codepoint >= FONT_GLYPH_INDEX_CODEPOINTS) {
+    return (int)(codepoint - FONT_GLYPH_INDEX_CODEPOINTS);
+  }
+  return stbtt_FindGlyphIndex(info, (int)codepoint);
+}
+
+bool font_glyph_table_full(Program::Fonts *fonts) {
+  return fonts->num_glyph_slots >= FONT_GLYPH_TABLE_SLOTS;
+}
+
+// caches a glyph that just went into the atlas and gives it the next glyph table slot
+void insert_font_glyph(Program::Fonts *fonts, uint32 glyph_id, Program::Fonts::Glyph glyph) {
+  assert(!font_glyph_table_full(fonts));
+  glyph.slot = fonts->num_glyph_slots++;
+  stbtt_packedchar *pc = &glyph.packed_char;
+  fonts->glyph_table[glyph.slot] = {pc->xoff, pc->yoff, pc->xoff2, pc->yoff2, (float)pc->x0, (float)pc->y0, (float)pc->x1, (float)pc->y1};
+  hash_map_insert(&fonts->glyphs, glyph_id, glyph);
+}
+
+// smallest power of two height holding content_h rows, clamped to [FONT_ATLAS_MIN_HEIGHT, max_h]
+int fit_font_atlas_height(int content_h, int max_h) {
+  int h = FONT_ATLAS_MIN_HEIGHT;
+  while (h < content_h && h < max_h) {
+    h *= 2;
+  }
+  return min(h, max_h);
+}
+
+// a fresh texture is undefined and evicted glyphs leave stale texels behind, but padding has to sample as 0
+void clear_font_atlas_texture(Program::Fonts *fonts, int first_row = 0) {
+  int strip_h = 64;
+  byte *zeros = CALLOC(byte, fonts->atlas_w * strip_h);
+  DEFER(FREE(zeros));
+  glBindTexture(GL_TEXTURE_2D, fonts->atlas_gl_texture_id);
+  for (int y = first_row; y < fonts->atlas_h; y += strip_h) {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, fonts->atlas_w, min(strip_h, fonts->atlas_h - y), GL_RED, GL_UNSIGNED_BYTE, zeros);
+  }
+  fonts->atlas_mipmaps_dirty = true;
+}
+
+// replaces the texture with one h rows tall. the first keep_rows rows are copied over on the gpu through a
+// framebuffer, the rest is left undefined for the caller to clear
+void resize_font_atlas_texture(Program::Fonts *fonts, int h, int keep_rows) {
+  GLuint texture_id;
+  glGenTextures(1, &texture_id);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, fonts->atlas_w, h, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, fonts->atlas_mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  if (fonts->atlas_gl_texture_id && keep_rows > 0) {
+    GLint prev_framebuffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_framebuffer); // glkit draws into its own framebuffer
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fonts->atlas_gl_texture_id, 0);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, fonts->atlas_w, min(keep_rows, h));
+    glBindFramebuffer(GL_FRAMEBUFFER, prev_framebuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+  }
+  if (fonts->atlas_gl_texture_id) {
+    glDeleteTextures(1, &fonts->atlas_gl_texture_id);
+  }
+  fonts->atlas_gl_texture_id = texture_id;
+  fonts->atlas_h = h;
+  fonts->pack_context.height = h;
+  ((stbrp_context *)fonts->pack_context.pack_info)->height = h - FONT_ATLAS_PADDING; // the skyline itself is unaffected
+  fonts->atlas_mipmaps_dirty = true;
+}
+
+// doubles the atlas height, keeping every glyph where it is. glyph instances keep working, the glyph table is in
+// texels and the shader divides by the atlas size it is drawn with
+bool grow_font_atlas(Program::Fonts *fonts) {
+  if (fonts->atlas_h >= fonts->atlas_max_h) {
+    return false;
+  }
+  int old_h = fonts->atlas_h;
+  resize_font_atlas_texture(fonts, min(old_h * 2, fonts->atlas_max_h), old_h);
+  clear_font_atlas_texture(fonts, old_h);
+  LOGI("font atlas grown to %dx%d", fonts->atlas_w, fonts->atlas_h);
+  return true;
+}
+
+// call before drawing with the atlas
+void update_font_atlas_mipmaps(Program::Fonts *fonts) {
+  if (fonts->atlas_mipmaps && fonts->atlas_mipmaps_dirty) {
+    glBindTexture(GL_TEXTURE_2D, fonts->atlas_gl_texture_id);
+    glGenerateMipmap(GL_TEXTURE_2D);
+  }
+  fonts->atlas_mipmaps_dirty = false;
+}
+
+// uploads the rows holding slots handed out since the last call, call before drawing glyph instances
+void update_font_glyph_table(Program::Fonts *fonts) {
+  if (fonts->num_glyph_slots_uploaded < fonts->num_glyph_slots) {
+    uint32 first_row = fonts->num_glyph_slots_uploaded / FONT_GLYPH_TABLE_ROW_SLOTS;
+    uint32 end_row = (fonts->num_glyph_slots + FONT_GLYPH_TABLE_ROW_SLOTS - 1) / FONT_GLYPH_TABLE_ROW_SLOTS;
+    glBindTexture(GL_TEXTURE_2D, fonts->glyph_table_gl_texture_id);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first_row, FONT_GLYPH_TABLE_ROW_SLOTS * 2, end_row - first_row, GL_RGBA, GL_FLOAT,
+                    &fonts->glyph_table[first_row * FONT_GLYPH_TABLE_ROW_SLOTS]);
+  }
+  fonts->num_glyph_slots_uploaded = fonts->num_glyph_slots;
+}
+
+// reserves the top rows of the packer for the baked glyphs and uploads them, no rasterization involved
+void put_baked_glyphs_into_font_atlas(Program::Fonts *fonts) {
+  auto *header = (const BakedFontAtlasHeader *)fonts->baked_atlas.data;
+  auto *baked_glyphs = (const BakedFontGlyph *)(header + 1);
+  const byte *pixels = (const byte *)(baked_glyphs + header->num_glyphs);
+  stbrp_rect rect = {};
+  rect.w = (stbrp_coord)(fonts->atlas_w - FONT_ATLAS_PADDING);
+  rect.h = (stbrp_coord)(header->baked_h - FONT_ATLAS_PADDING);
+  stbtt_PackFontRangesPackRects(&fonts->pack_context, &rect, 1);
+  assert(rect.was_packed && rect.x == 0 && rect.y == 0);
+  glBindTexture(GL_TEXTURE_2D, fonts->atlas_gl_texture_id);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, header->atlas_w, header->baked_h, GL_RED, GL_UNSIGNED_BYTE, pixels);
+  hash_map_reserve(&fonts->glyphs, header->num_glyphs);
+  for (uint32 i = 0; i < header->num_glyphs; ++i) {
+    Program::Fonts::Glyph glyph = {};
+    glyph.packed_char = baked_glyphs[i].packed_char;
+    glyph.font = fonts->baked_atlas_font;
+    insert_font_glyph(fonts, font_glyph_id(fonts, fonts->baked_atlas_font, baked_glyphs[i].codepoint), glyph);
+  }
+}
+
+// keeps the atlas size, except that it grows when a newly installed baked atlas does not fit
+void reset_font_glyphs(Program::Fonts *fonts) {
+  hash_map_clear(&fonts->glyphs);
+  fonts->num_glyph_slots = 0;
+  fonts->num_glyph_slots_uploaded = 0;
+  if (fonts->baked_atlas.data) {
+    int baked_h = (int)((const BakedFontAtlasHeader *)fonts->baked_atlas.data)->baked_h;
+    if (baked_h > fonts->atlas_h) {
+      resize_font_atlas_texture(fonts, fit_font_atlas_height(baked_h, fonts->atlas_max_h), 0);
+    }
+  }
+  int num_nodes = fonts->atlas_w - FONT_ATLAS_PADDING;
+  stbrp_init_target((stbrp_context *)fonts->pack_context.pack_info, fonts->atlas_w - FONT_ATLAS_PADDING, fonts->atlas_h - FONT_ATLAS_PADDING, (stbrp_node *)fonts->pack_context.nodes, num_nodes);
+  clear_font_atlas_texture(fonts);
+  if (fonts->baked_atlas.data) {
+    put_baked_glyphs_into_font_atlas(fonts);
+  }
+  fonts->atlas_generation += 1;
+}
+
+// touches no program state, safe on any thread. returns why the baked atlas cannot be used, or null if it can
+const char *check_baked_font_atlas(const byte *baked_atlas, uint32 baked_atlas_len, const byte *ttf, uint32 ttf_len, float raster_size, int atlas_w, int atlas_h) {
+  auto *header = (const BakedFontAtlasHeader *)baked_atlas;
+  if (baked_atlas_len < sizeof(BakedFontAtlasHeader) || header->magic != BAKED_FONT_ATLAS_MAGIC) {
+    return "not a baked font atlas";
+  } else if (header->version != BAKED_FONT_ATLAS_VERSION) {
+    return "version mismatch";
+  } else if (header->font_size != raster_size || header->oversampling != 2 ||
+             header->padding != FONT_ATLAS_PADDING || header->atlas_w != (uint32)atlas_w ||
+             header->baked_h > (uint32)atlas_h || header->baked_h <= FONT_ATLAS_PADDING) {
+    return "baked with different atlas parameters";
+  } else if (baked_atlas_len != sizeof(BakedFontAtlasHeader) + header->num_glyphs * sizeof(BakedFontGlyph) + header->atlas_w * header->baked_h) {
+    return "size mismatch";
+  } else if (header->ttf_hash != baked_font_atlas_hash(ttf, ttf_len)) {
+    return "baked from a different ttf";
+  }
+  return nullptr;
+}
+
+// takes ownership of baked_atlas, which must already have passed check_baked_font_atlas for the font
+void install_baked_font_atlas(Program::Fonts *fonts, uint32 font, FileMap *baked_atlas) {
+  assert(!fonts->sdf);
+  unmap_file(&fonts->baked_atlas);
+  fonts->baked_atlas = *baked_atlas;
+  *baked_atlas = {};
+  fonts->baked_atlas_font = font;
+  if (fonts->atlas_gl_texture_id) {
+    reset_font_glyphs(fonts);
+  }
+}
+
+// called once per gl context, glyphs from a lost context are rasterized again on demand. the atlas starts trimmed to
+// the baked glyphs and grows as other glyphs come in
+void init_font_atlas_texture(Program::Fonts *fonts) {
+  fonts->atlas_gl_texture_id = 0; // gone with the old context, if any
+  glGenTextures(1, &fonts->glyph_table_gl_texture_id);
+  glBindTexture(GL_TEXTURE_2D, fonts->glyph_table_gl_texture_id);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, FONT_GLYPH_TABLE_ROW_SLOTS * 2, FONT_GLYPH_TABLE_SLOTS / FONT_GLYPH_TABLE_ROW_SLOTS, 0, GL_RGBA, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  int baked_h = fonts->baked_atlas.data ? (int)((const BakedFontAtlasHeader *)fonts->baked_atlas.data)->baked_h : 0;
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  resize_font_atlas_texture(fonts, fit_font_atlas_height(baked_h, fonts->atlas_max_h), 0);
+  reset_font_glyphs(fonts);
+}
+
+// stb_truetype 1.08 has no stbtt_GetCodepointSDF, this follows its conventions: 128 on the outline, rising
+// inside, FONT_SDF_SPREAD pixels to 0 or 255. exact distances to the flattened outline, sign by nonzero winding
+void make_glyph_sdf(stbtt_fontinfo *info, int glyph, float scale, byte *sdf, int w, int h, int stride, int x0, int y0) {
+  struct Segment {
+    float x0, y0, x1, y1;
+  };
+  stbtt_vertex *verts;
+  int num_verts = stbtt_GetGlyphShape(info, glyph, &verts);
+  DEFER(stbtt_FreeShape(info, verts));
+  Segment *segments = nullptr;
+  DEFER(delete_array(segments));
+  float start_x = 0, start_y = 0, x = 0, y = 0;
+  auto line_to = [&](float to_x, float to_y) {
+    if (to_x != x || to_y != y) {
+      array_push(&segments, Segment{x, y, to_x, to_y});
+    }
+    x = to_x, y = to_y;
+  };
+  for (int i = 0; i < num_verts; ++i) { // bitmap space, y down
+    float vx = verts[i].x * scale;
+    float vy = -verts[i].y * scale;
+    if (verts[i].type == STBTT_vmove) {
+      line_to(start_x, start_y);
+      start_x = x = vx, start_y = y = vy;
+    } else if (verts[i].type == STBTT_vline) {
+      line_to(vx, vy);
+    } else if (verts[i].type == STBTT_vcurve) {
+      float cx = verts[i].cx * scale;
+      float cy = -verts[i].cy * scale;
+      float px = x, py = y;
+      int num_steps = 8;
+      for (int step = 1; step <= num_steps; ++step) {
+        float t = (float)step / num_steps;
+        float it = 1 - t;
+        line_to(it * it * px + 2 * it * t * cx + t * t * vx, it * it * py + 2 * it * t * cy + t * t * vy);
+      }
+    }
+  }
+  line_to(start_x, start_y);
+
+  uint32 num_segments = array_size(segments);
+  float value_per_pixel = 128.0f / FONT_SDF_SPREAD;
+  for (int j = 0; j < h; ++j) {
+    for (int i = 0; i < w; ++i) {
+      float px = x0 + i + 0.5f;
+      float py = y0 + j + 0.5f;
+      float min_dist_sq = FLT_MAX;
+      int winding = 0;
+      for (uint32 k = 0; k < num_segments; ++k) {
+        Segment *seg = &segments[k];
+        float dx = seg->x1 - seg->x0;
+        float dy = seg->y1 - seg->y0;
+        float len_sq = dx * dx + dy * dy;
+        float t = len_sq > 0 ? ((px - seg->x0) * dx + (py - seg->y0) * dy) / len_sq : 0;
+        t = max(0.0f, min(1.0f, t));
+        float ex = seg->x0 + t * dx - px;
+        float ey = seg->y0 + t * dy - py;
+        min_dist_sq = min(min_dist_sq, ex * ex + ey * ey);
+        if ((seg->y0 <= py) != (seg->y1 <= py)) {
+          float cross_x = seg->x0 + (py - seg->y0) / dy * dx;
+          if (cross_x > px) {
+            winding += dy > 0 ? 1 : -1;
+          }
+        }
+      }
+      float dist = sqrtf(min_dist_sq);
+      float value = 128.0f + (winding ? dist : -dist) * value_per_pixel;
+      sdf[j * stride + i] = (byte)max(0.0f, min(255.0f, value));
+    }
+  }
+}
+
+// one glyph on its way into the atlas: sized and packed on the gl thread, rendered anywhere, uploaded on the gl thread
+struct GlyphRaster {
+  uint32 font;
+  uint32 codepoint;
+  stbrp_rect rect; // padding included
+  stbtt_packedchar packed_char;
+  byte *bitmap; // rect.w * rect.h, padding included
+};
+
+void size_font_glyph(Program::Fonts *fonts, GlyphRaster *raster) {
+  auto *font = &fonts->fonts[raster->font];
+  stbtt_fontinfo *info = &fonts->faces[font->face].info;
+  int glyph = font_codepoint_glyph_index(info, raster->codepoint);
+  float scale = stbtt_ScaleForPixelHeight(info, font->raster_size);
+  raster->rect = {};
+  if (fonts->sdf) {
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBox(info, glyph, scale, scale, &x0, &y0, &x1, &y1);
+    raster->rect.w = (stbrp_coord)(x1 - x0 + 2 * FONT_SDF_SPREAD + FONT_ATLAS_PADDING);
+    raster->rect.h = (stbrp_coord)(y1 - y0 + 2 * FONT_SDF_SPREAD + FONT_ATLAS_PADDING);
+  } else { // as stbtt_PackFontRangesGatherRects, which only takes codepoints
+    stbtt_pack_context *spc = &fonts->pack_context;
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBoxSubpixel(info, glyph, scale * spc->h_oversample, scale * spc->v_oversample, 0, 0, &x0, &y0, &x1, &y1);
+    raster->rect.w = (stbrp_coord)(x1 - x0 + spc->padding + spc->h_oversample - 1);
+    raster->rect.h = (stbrp_coord)(y1 - y0 + spc->padding + spc->v_oversample - 1);
+  }
+}
+
+// only reads font data and writes the raster, safe to run on several threads at once
+void render_font_glyph(Program::Fonts *fonts, GlyphRaster *raster) {
+  auto *font = &fonts->fonts[raster->font];
+  stbtt_fontinfo *info = &fonts->faces[font->face].info;
+  int glyph = font_codepoint_glyph_index(info, raster->codepoint);
+  float scale = stbtt_ScaleForPixelHeight(info, font->raster_size);
+  int x = raster->rect.x;
+  int y = raster->rect.y;
+  int w = raster->rect.w;
+  int h = raster->rect.h;
+  raster->bitmap = CALLOC(byte, w * h);
+  int advance, lsb, x0, y0, x1, y1;
+  stbtt_GetGlyphHMetrics(info, glyph, &advance, &lsb);
+  stbtt_packedchar *packed_char = &raster->packed_char;
+  if (fonts->sdf) {
+    stbtt_GetGlyphBitmapBox(info, glyph, scale, scale, &x0, &y0, &x1, &y1);
+    x0 -= FONT_SDF_SPREAD;
+    y0 -= FONT_SDF_SPREAD;
+    x1 += FONT_SDF_SPREAD;
+    y1 += FONT_SDF_SPREAD;
+    byte *sdf = raster->bitmap + FONT_ATLAS_PADDING * w + FONT_ATLAS_PADDING;
+    make_glyph_sdf(info, glyph, scale, sdf, x1 - x0, y1 - y0, w, x0, y0);
+    packed_char->x0 = (unsigned short)(x + FONT_ATLAS_PADDING);
+    packed_char->y0 = (unsigned short)(y + FONT_ATLAS_PADDING);
+    packed_char->x1 = (unsigned short)(x + w);
+    packed_char->y1 = (unsigned short)(y + h);
+    packed_char->xadvance = scale * advance;
+    packed_char->xoff = (float)x0;
+    packed_char->yoff = (float)y0;
+    packed_char->xoff2 = (float)x1;
+    packed_char->yoff2 = (float)y1;
+  } else { // as stbtt_PackFontRangesRenderIntoRects, oversampled and box filtered
+    stbtt_pack_context *spc = &fonts->pack_context;
+    int h_over = spc->h_oversample;
+    int v_over = spc->v_oversample;
+    int pad = spc->padding;
+    byte *pixels = raster->bitmap + pad * w + pad;
+    stbtt_MakeGlyphBitmapSubpixel(info, pixels, w - pad - h_over + 1, h - pad - v_over + 1, w, scale * h_over, scale * v_over, 0, 0, glyph);
+    if (h_over > 1) {
+      stbtt__h_prefilter(pixels, w - pad, h - pad, w, h_over);
+    }
+    if (v_over > 1) {
+      stbtt__v_prefilter(pixels, w - pad, h - pad, w, v_over);
+    }
+    stbtt_GetGlyphBitmapBox(info, glyph, scale * h_over, scale * v_over, &x0, &y0, &x1, &y1);
+    packed_char->x0 = (unsigned short)(x + pad);
+    packed_char->y0 = (unsigned short)(y + pad);
+    packed_char->x1 = (unsigned short)(x + w);
+    packed_char->y1 = (unsigned short)(y + h);
+    packed_char->xadvance = scale * advance;
+    packed_char->xoff = (float)x0 / h_over + stbtt__oversample_shift(h_over);
+    packed_char->yoff = (float)y0 / v_over + stbtt__oversample_shift(v_over);
+    packed_char->xoff2 = (float)(x0 + w - pad) / h_over + stbtt__oversample_shift(h_over);
+    packed_char->yoff2 = (float)(y0 + h - pad) / v_over + stbtt__oversample_shift(v_over);
+  }
+}
+
+// sizes and packs the whole batch on this thread, renders it on the worker pool into disjoint bitmaps, then uploads
+// each rect here. returns false if some glyph did not fit, those are left with rect.was_packed 0
+bool rasterize_font_glyphs(Program::Fonts *fonts, GlyphRaster *rasters, uint32 num_rasters) {
+  stbrp_rect *rects = MALLOC(stbrp_rect, max(num_rasters, 1u));
+  DEFER(FREE(rects));
+  for (uint32 i = 0; i < num_rasters; ++i) {
+    size_font_glyph(fonts, &rasters[i]);
+    rects[i] = rasters[i].rect;
+  }
+  stbtt_PackFontRangesPackRects(&fonts->pack_context, rects, num_rasters); // sorted by height inside, order is kept
+  for (;;) { // grow for whatever did not fit, the packed rects stay where they are
+    uint32 num_unpacked = 0;
+    for (uint32 i = 0; i < num_rasters; ++i) {
+      if (rects[i].was_packed) {
+        rasters[i].rect = rects[i];
+      } else {
+        rects[num_unpacked++] = rects[i];
+      }
+    }
+    if (num_unpacked == 0 || !grow_font_atlas(fonts)) {
+      break;
+    }
+    stbtt_PackFontRangesPackRects(&fonts->pack_context, rects, num_unpacked);
+    for (uint32 i = 0, j = 0; i < num_rasters; ++i) {
+      if (!rasters[i].rect.was_packed) {
+        rasters[i].rect = rects[j++];
+      }
+    }
+    for (uint32 i = 0; i < num_rasters; ++i) {
+      rects[i] = rasters[i].rect;
+    }
+  }
+  bool all_packed = true;
+  for (uint32 i = 0; i < num_rasters; ++i) {
+    all_packed = all_packed && rasters[i].rect.was_packed;
+  }
+  struct RenderJob {
+    Program::Fonts *fonts;
+    GlyphRaster *rasters;
+  } job = {fonts, rasters};
+  parallel_for(fonts->worker_pool, num_rasters, [](void *data, uint32 index) {
+    RenderJob *job = (RenderJob *)data;
+    if (job->rasters[index].rect.was_packed) {
+      render_font_glyph(job->fonts, &job->rasters[index]);
+    }
+  }, &job);
+  glBindTexture(GL_TEXTURE_2D, fonts->atlas_gl_texture_id);
+  for (uint32 i = 0; i < num_rasters; ++i) {
+    GlyphRaster *raster = &rasters[i];
+    if (raster->rect.was_packed) {
+      glTexSubImage2D(GL_TEXTURE_2D, 0, raster->rect.x, raster->rect.y, raster->rect.w, raster->rect.h, GL_RED, GL_UNSIGNED_BYTE, raster->bitmap);
+      FREE(raster->bitmap);
+      raster->bitmap = nullptr;
+    }
+  }
+  fonts->atlas_mipmaps_dirty = true;
+  return all_packed;
+}
+
+bool rasterize_font_glyph(Program::Fonts *fonts, uint32 font, uint32 codepoint, stbtt_packedchar *packed_char) {
+  GlyphRaster raster = {};
+  raster.font = font;
+  raster.codepoint = codepoint;
+  if (!rasterize_font_glyphs(fonts, &raster, 1)) {
+    return false;
+  }
+  *packed_char = raster.packed_char;
+  return true;
+}
+
+// the skyline packer cannot free single rects, so start over with the most recently used glyphs
+// until half of the atlas is taken again
+void evict_font_glyphs(Program::Fonts *fonts) {
+  struct GlyphUse {
+    uint32 glyph_id;
+    uint32 font;
+    uint32 last_use;
+  };
+  uint32 num_glyphs = 0;
+  GlyphUse *glyph_uses = MALLOC(GlyphUse, max(fonts->glyphs.size, 1u));
+  DEFER(FREE(glyph_uses));
+  hash_map_for_each(&fonts->glyphs, [&](uint32 glyph_id, Program::Fonts::Glyph *glyph) {
+    glyph_uses[num_glyphs++] = {glyph_id, glyph->font, glyph->last_use};
+  });
+  qsort(glyph_uses, num_glyphs, sizeof(GlyphUse), [](const void *a, const void *b) -> int {
+    uint32 a_use = ((const GlyphUse *)a)->last_use;
+    uint32 b_use = ((const GlyphUse *)b)->last_use;
+    return a_use < b_use ? 1 : (a_use > b_use ? -1 : 0);
+  });
+  reset_font_glyphs(fonts);
+  uint32 area = fonts->baked_atlas.data ? fonts->atlas_w * ((const BakedFontAtlasHeader *)fonts->baked_atlas.data)->baked_h : 0;
+  uint32 area_budget = fonts->atlas_w * fonts->atlas_h / 2;
+  GlyphRaster *rasters = MALLOC(GlyphRaster, max(num_glyphs, 1u));
+  DEFER(FREE(rasters));
+  uint32 *last_uses = MALLOC(uint32, max(num_glyphs, 1u));
+  DEFER(FREE(last_uses));
+  uint32 num_rasters = 0;
+  uint32 slot_budget = FONT_GLYPH_TABLE_SLOTS / 2;
+  for (uint32 i = 0; i < num_glyphs && area < area_budget && fonts->num_glyph_slots + num_rasters < slot_budget; ++i) {
+    GlyphUse *use = &glyph_uses[i];
+    if (Program::Fonts::Glyph *baked_glyph = hash_map_find(&fonts->glyphs, use->glyph_id)) {
+      baked_glyph->last_use = use->last_use;
+      continue;
+    }
+    GlyphRaster *raster = &rasters[num_rasters];
+    *raster = {};
+    raster->font = use->font;
+    raster->codepoint = use->glyph_id & ((1u << FONT_GLYPH_CODEPOINT_BITS) - 1);
+    size_font_glyph(fonts, raster);
+    area += raster->rect.w * raster->rect.h;
+    last_uses[num_rasters++] = use->last_use;
+  }
+  rasterize_font_glyphs(fonts, rasters, num_rasters);
+  uint32 num_kept = 0;
+  for (uint32 i = 0; i < num_rasters; ++i) {
+    if (rasters[i].rect.was_packed) {
+      Program::Fonts::Glyph glyph = {};
+      glyph.packed_char = rasters[i].packed_char;
+      glyph.last_use = last_uses[i];
+      glyph.font = rasters[i].font;
+      insert_font_glyph(fonts, font_glyph_id(fonts, rasters[i].font, rasters[i].codepoint), glyph);
+      num_kept += 1;
+    }
+  }
+  LOGI("font atlas full, rasterized %u of %u glyphs again", num_kept, num_glyphs);
+}
+
+// rasterizes the codepoints missing from the atlas as one batch, so a run of new glyphs (pasted cjk text, a fresh
+// font) renders in parallel. whatever does not fit is left to get_font_glyph and its eviction
+void prefetch_font_glyphs(Program::Fonts *fonts, uint32 font, const uint32 *codepoints, uint32 num_codepoints) {
+  GlyphRaster *rasters = nullptr;
+  DEFER(delete_array(rasters));
+  HashMap<uint32, bool> batched = {};
+  DEFER(delete_hash_map(&batched));
+  for (uint32 i = 0; i < num_codepoints; ++i) {
+    uint32 glyph_id = font_glyph_id(fonts, font, codepoints[i]);
+    if (!hash_map_find(&fonts->glyphs, glyph_id) && !hash_map_find(&batched, glyph_id) &&
+        fonts->num_glyph_slots + batched.size < FONT_GLYPH_TABLE_SLOTS) {
+      hash_map_insert(&batched, glyph_id, true);
+      GlyphRaster raster = {};
+      raster.font = font;
+      raster.codepoint = codepoints[i];
+      array_push(&rasters, raster);
+    }
+  }
+  uint32 num_rasters = array_size(rasters);
+  if (num_rasters < 2) {
+    return;
+  }
+  rasterize_font_glyphs(fonts, rasters, num_rasters);
+  for (uint32 i = 0; i < num_rasters; ++i) {
+    if (rasters[i].rect.was_packed) {
+      Program::Fonts::Glyph glyph = {};
+      glyph.packed_char = rasters[i].packed_char;
+      glyph.last_use = fonts->use_clock;
+      glyph.font = font;
+      insert_font_glyph(fonts, font_glyph_id(fonts, font, rasters[i].codepoint), glyph);
+    }
+  }
+}
+
+bool get_font_glyph(Program::Fonts *fonts, uint32 font, uint32 codepoint, Program::Fonts::Glyph *glyph_out) {
+  fonts->use_clock += 1;
+  uint32 glyph_id = font_glyph_id(fonts, font, codepoint);
+  if (Program::Fonts::Glyph *glyph = hash_map_find(&fonts->glyphs, glyph_id)) {
+    glyph->last_use = fonts->use_clock;
+    *glyph_out = *glyph;
+    return true;
+  }
+  if (font_glyph_table_full(fonts)) {
+    evict_font_glyphs(fonts);
+  }
+  Program::Fonts::Glyph glyph = {};
+  if (!rasterize_font_glyph(fonts, font, codepoint, &glyph.packed_char)) {
+    evict_font_glyphs(fonts);
+    if (!rasterize_font_glyph(fonts, font, codepoint, &glyph.packed_char)) {
+      LOGW("glyph U+%04X does not fit in the font atlas", codepoint);
+      return false;
+    }
+  }
+  glyph.last_use = fonts->use_clock;
+  glyph.font = font;
+  insert_font_glyph(fonts, glyph_id, glyph);
+  *glyph_out = *hash_map_find(&fonts->glyphs, glyph_id);
+  return true;
+}
+
+// the first lookup of a codepoint goes through the cmap and hmtx tables, later ones are a hash map probe
+Program::Fonts::GlyphMetrics get_font_glyph_metrics(Program::Fonts::Face *face, uint32 codepoint) {
+  if (Program::Fonts::GlyphMetrics *metrics = hash_map_find(&face->glyph_metrics, codepoint)) {
+    return *metrics;
+  }
+  Program::Fonts::GlyphMetrics metrics = {};
+  metrics.glyph_index = stbtt_FindGlyphIndex(&face->info, (int)codepoint);
+  stbtt_GetGlyphHMetrics(&face->info, metrics.glyph_index, &metrics.advance, nullptr);
+  hash_map_insert(&face->glyph_metrics, codepoint, metrics);
+  return metrics;
+}
+
+// font units. pairs are cached as they come up rather than all at once, open sans alone has 18k of them
+int get_font_kern_advance(Program::Fonts::Face *face, int glyph_index_1, int glyph_index_2) {
+  if (!face->info.kern) {
+    return 0;
+  }
+  uint32 key = (uint32)glyph_index_1 << 16 | (uint32)glyph_index_2;
+  if (int16 *kern_advance = hash_map_find(&face->kern_advances, key)) {
+    return *kern_advance;
+  }
+  int16 kern_advance = (int16)stbtt_GetGlyphKernAdvance(&face->info, glyph_index_1, glyph_index_2);
+  hash_map_insert(&face->kern_advances, key, kern_advance);
+  return kern_advance;
+}
+
+// the combining diacritical mark blocks. a mark draws over the char before it and is never split off from it
+bool is_combining_mark(uint32 codepoint) {
+  return (codepoint >= 0x300 && codepoint <= 0x36f) || (codepoint >= 0x1ab0 && codepoint <= 0x1aff) ||
+         (codepoint >= 0x1dc0 && codepoint <= 0x1dff) || (codepoint >= 0x20d0 && codepoint <= 0x20ff) ||
+         (codepoint >= 0xfe20 && codepoint <= 0xfe2f);
+}
+
+// index of the glyph in an opentype coverage table, -1 if it is not covered
+int font_coverage_index(const stbtt_uint8 *coverage, int glyph_index) {
+  uint32 format = ttUSHORT(coverage);
+  uint32 lo = 0;
+  uint32 hi = ttUSHORT(coverage + 2);
+  while (lo < hi) {
+    uint32 mid = (lo + hi) / 2;
+    if (format == 1) {
+      int glyph = ttUSHORT(coverage + 4 + 2 * mid);
+      if (glyph == glyph_index) {
+        return (int)mid;
+      }
+      glyph < glyph_index ? lo = mid + 1 : hi = mid;
+    } else if (format == 2) {
+      const stbtt_uint8 *range = coverage + 4 + 6 * mid; // first glyph, last glyph, coverage index of the first
+      if (glyph_index < ttUSHORT(range)) {
+        hi = mid;
+      } else if (glyph_index > ttUSHORT(range + 2)) {
+        lo = mid + 1;
+      } else {
+        return ttUSHORT(range + 4) + glyph_index - ttUSHORT(range);
+      }
+    } else {
+      break;
+    }
+  }
+  return -1;
+}
+
+// replaces glyph sequences with their ligatures, subtable by subtable over the whole run as gsub lookups go. a
+// ligature takes the cluster of its first glyph
+void substitute_font_ligatures(Program::Fonts::Face *face, Program::Fonts::ShapedGlyph **glyphs) {
+  const stbtt_uint8 *data = face->info.data;
+  for (uint32 s = 0; s < array_size(face->ligature_subtables); ++s) {
+    const stbtt_uint8 *subtable = data + face->ligature_subtables[s];
+    uint32 num_sets = ttUSHORT(subtable + 4);
+    for (uint32 i = 0; i < array_size(*glyphs); ++i) {
+      auto *glyph = &(*glyphs)[i];
+      int coverage_index = font_coverage_index(subtable + ttUSHORT(subtable + 2), glyph->glyph_index);
+      if (coverage_index < 0 || (uint32)coverage_index >= num_sets) {
+        continue;
+      }
+      const stbtt_uint8 *set = subtable + ttUSHORT(subtable + 6 + 2 * coverage_index);
+      for (uint32 j = 0; j < ttUSHORT(set); ++j) { // in order of preference, longest first
+        const stbtt_uint8 *ligature = set + ttUSHORT(set + 2 + 2 * j);
+        uint32 num_components = ttUSHORT(ligature + 2);
+        if (num_components < 1 || i + num_components > array_size(*glyphs)) {
+          continue;
+        }
+        uint32 k = 1;
+        while (k < num_components && (*glyphs)[i + k].glyph_index == ttUSHORT(ligature + 4 + 2 * (k - 1))) {
+          k += 1;
+        }
+        if (k == num_components) {
+          glyph->glyph_index = ttUSHORT(ligature);
+          glyph->codepoint = FONT_GLYPH_INDEX_CODEPOINTS + glyph->glyph_index;
+          uint32 num_glyphs = array_size(*glyphs);
+          memmove(glyph + 1, glyph + num_components, (num_glyphs - i - num_components) * sizeof(Program::Fonts::ShapedGlyph));
+          array_resize(glyphs, num_glyphs - (num_components - 1));
+          break;
+        }
       }
     }
-    GLint status;
-    glGetProgramiv(shader_id, GL_LINK_STATUS, &status);
-    if (status == GL_FALSE) {
-      glDeleteProgram(shader_id);
-      glDeleteShader(vs_id);
-      glDeleteShader(fs_id);
-      return 0;
-    }
-    glDetachShader(shader_id, vs_id);
-    glDetachShader(shader_id, fs_id);
-    glDeleteShader(vs_id);
-    glDeleteShader(fs_id);
-    return shader_id;
-  };
-  auto create_shader = [&](const char* shader_name, const char *src) -> GLuint {
-    ProgramSrc psrc = split_src_string(src);
-    GLuint vs_id = compile_shader(shader_name, psrc.vert_shader, psrc.vert_shader_len, GL_VERTEX_SHADER);
-    GLuint fs_id = compile_shader(shader_name, psrc.frag_shader, psrc.frag_shader_len, GL_FRAGMENT_SHADER);
-    GLuint shader_id = link_shader(shader_name, vs_id, fs_id);
-    return shader_id;
+  }
+}
+
+uint64 hash_text_run(uint32 font, const char *text, uint32 len) { // fnv-1a
+  uint64 hash = 0xcbf29ce484222325ull;
+  for (uint32 i = 0; i < 4; ++i) {
+    hash = (hash ^ (font >> (8 * i) & 0xff)) * 0x100000001b3ull;
+  }
+  for (uint32 i = 0; i < len; ++i) {
+    hash = (hash ^ (uchar)text[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// drops the least recently used half of the shaped runs, like evict_font_glyphs does with glyphs
+void evict_shaped_text_runs(Program::Fonts *fonts) {
+  struct RunUse {
+    uint64 hash;
+    uint32 last_use;
   };
-  { // text shader
-    const char *src = R"(
-      [Vertex Shader Stage]
-      uniform mat4 mvp_mat;
-      attribute vec3 position;
-      attribute vec4 color;
-      attribute vec2 tcoord;
-      varying vec4 color_vs;
-      varying vec2 tcoord_vs;
-      void main() {
-        color_vs = color;
-        tcoord_vs = tcoord;
-        gl_Position = mvp_mat * vec4(position, 1.0);
+  uint32 num_runs = 0;
+  RunUse *run_uses = MALLOC(RunUse, max(fonts->shaped_runs.size, 1u));
+  DEFER(FREE(run_uses));
+  hash_map_for_each(&fonts->shaped_runs, [&](uint64 hash, Program::Fonts::ShapedRun *run) {
+    run_uses[num_runs++] = {hash, run->last_use};
+  });
+  qsort(run_uses, num_runs, sizeof(RunUse), [](const void *a, const void *b) -> int {
+    uint32 a_use = ((const RunUse *)a)->last_use;
+    uint32 b_use = ((const RunUse *)b)->last_use;
+    return a_use < b_use ? 1 : (a_use > b_use ? -1 : 0);
+  });
+  for (uint32 i = num_runs / 2; i < num_runs; ++i) {
+    Program::Fonts::ShapedRun run = {};
+    hash_map_remove(&fonts->shaped_runs, run_uses[i].hash, &run);
+    delete_array(run.text);
+    delete_array(run.glyphs);
+  }
+}
+
+// turns text into positioned glyphs of one font: cmap, gsub ligatures, kerning, and combining marks centered over
+// their base, above or below it. stb_truetype has no gpos, so mark placement goes by glyph boxes rather than anchors.
+// runs are cached by font and text, a repeated word is a hash lookup. the run stays valid until the next call
+const Program::Fonts::ShapedRun *shape_text_run(Program::Fonts *fonts, uint32 font, const char *text, uint32 len) {
+  fonts->shape_clock += 1;
+  uint64 hash = hash_text_run(font, text, len);
+  Program::Fonts::ShapedRun *run = hash_map_find(&fonts->shaped_runs, hash);
+  if (run && run->font == font && array_size(run->text) == len && !memcmp(run->text, text, len)) {
+    run->last_use = fonts->shape_clock;
+    return run;
+  }
+  if (!run) { // a hash collision shapes over the other run
+    if (fonts->shaped_runs.size >= FONT_SHAPED_RUN_CACHE_SIZE) {
+      evict_shaped_text_runs(fonts);
+    }
+    run = hash_map_insert(&fonts->shaped_runs, hash, Program::Fonts::ShapedRun{});
+  }
+  run->font = font;
+  run->last_use = fonts->shape_clock;
+  array_resize(&run->text, len);
+  memcpy(run->text, text, len);
+  array_clear(run->glyphs);
+  auto *f = &fonts->fonts[font];
+  auto *face = &fonts->faces[f->face];
+  for (const char *str = text; str < text + len;) {
+    Program::Fonts::ShapedGlyph glyph = {};
+    glyph.cluster = (uint32)(str - text);
+    glyph.codepoint = utf8_decode(&str, text + len);
+    glyph.glyph_index = get_font_glyph_metrics(face, glyph.codepoint).glyph_index;
+    array_push(&run->glyphs, glyph);
+  }
+  substitute_font_ligatures(face, &run->glyphs);
+  float pen_x = 0;
+  int prev_glyph_index = -1;
+  int base_x0 = 0, base_x1 = 0; // box of the last glyph that was not a mark, font units
+  int top = 0, bottom = 0; // of the base and the marks stacked on it so far
+  float base_x = 0;
+  uint32 base_cluster = 0;
+  for (uint32 i = 0; i < array_size(run->glyphs); ++i) {
+    auto *glyph = &run->glyphs[i];
+    int advance, x0, y0, x1, y1;
+    stbtt_GetGlyphHMetrics(&face->info, glyph->glyph_index, &advance, nullptr);
+    bool has_box = stbtt_GetGlyphBox(&face->info, glyph->glyph_index, &x0, &y0, &x1, &y1);
+    if (is_combining_mark(glyph->codepoint) && i > 0) {
+      glyph->cluster = base_cluster;
+      if (!has_box || glyph->glyph_index == 0) { // no outline, like U+034F, or not in the font. nothing to stack
+        glyph->x = base_x;
+        glyph->y = 0;
+        continue;
       }
-      [Fragment Shader Stage]
-      uniform sampler2D tex;
-      varying mediump vec4 color_vs;
-      varying mediump vec2 tcoord_vs;
-      void main() {
-        gl_FragColor.rgb = color_vs.rgb;
-        gl_FragColor.a = texture2D(tex, tcoord_vs).a;
+      glyph->x = base_x + ((base_x0 + base_x1) - (x0 + x1)) * 0.5f * f->scale_factor;
+      if (y0 >= face->x_height / 2) { // above, keeping the gap the font left over the x height
+        int lift = top - face->x_height;
+        glyph->y = -lift * f->scale_factor;
+        top = y1 + lift;
+      } else if (y1 <= 0) { // below the baseline
+        glyph->y = -bottom * f->scale_factor;
+        bottom = y0 + bottom;
       }
-    )";
-    auto *shader = &shaders->text;
-    shader->id = create_shader("simple_texture", src);;
-    shader->uniform_mvp_mat = glGetUniformLocation(shader->id, "mvp_mat");
-    shader->uniform_tex = glGetUniformLocation(shader->id, "tex");
-    shader->attrib_position = glGetAttribLocation(shader->id, "position");
-    shader->attrib_color = glGetAttribLocation(shader->id, "color");
-    shader->attrib_tcoord = glGetAttribLocation(shader->id, "tcoord");
-    LOGI("loaded \"simple texture\" shader(id:%d)", shader->id);
+      continue;
+    }
+    if (prev_glyph_index >= 0) {
+      pen_x += get_font_kern_advance(face, prev_glyph_index, glyph->glyph_index) * f->scale_factor;
+    }
+    prev_glyph_index = glyph->glyph_index;
+    glyph->x = pen_x;
+    glyph->advance = advance * f->scale_factor;
+    pen_x += glyph->advance;
+    if (!has_box) { // a space to put a mark over
+      x0 = y0 = y1 = 0;
+      x1 = advance;
+    }
+    base_x = glyph->x;
+    base_x0 = x0;
+    base_x1 = x1;
+    top = max(y1, face->x_height);
+    bottom = min(y0, 0);
+    base_cluster = glyph->cluster;
   }
+  run->width = pen_x;
+  return run;
 }
 
-bool init_font(Program::Font *font, byte *font_buf) {
-  if (!stbtt_InitFont(&font->info, font_buf, 0)) {
-    LOGF("cannot init font info from font file");
-    return false;
+void delete_text_layout(TextLayout *layout) {
+  delete_array(layout->lines);
+  delete_array(layout->instances);
+  delete_array(layout->staged_lines);
+  delete_array(layout->staged_instances);
+  layout->lines = nullptr;
+  layout->instances = nullptr;
+  layout->staged_lines = nullptr;
+  layout->staged_instances = nullptr;
+}
+
+// lays out the line starting at byte begin, appending its instances and then empty ones up to its slot count.
+// lines end at newlines, or wrap at the last run of spaces that keeps them within max_width and at any glyph cluster
+// when a word is wider than that on its own. words go through shape_text_run, spaces and newlines get no instance
+TextLayout::Line layout_text_line(Program::Fonts *fonts, TextLayout *layout, const char *text, uint32 text_len, uint32 begin,
+                                  uint32 line_index, GlyphInstance **instances, bool *newline) {
+  auto *font = &fonts->fonts[layout->font];
+  auto *face = &fonts->faces[font->face];
+  float scale = font->size / font->raster_size;
+  assert(scale * GLYPH_INSTANCE_SCALE_ONE < 65536);
+  int16 line_y = text_vertex_coord(font->ascent + line_index % font->page_lines * font->line_height);
+  GlyphInstance instance = {};
+  instance.scale = (uint16)roundf(scale * GLYPH_INSTANCE_SCALE_ONE);
+  instance.r = (uint8)(layout->rgba >> 24);
+  instance.g = (uint8)(layout->rgba >> 16);
+  instance.b = (uint8)(layout->rgba >> 8);
+  instance.a = (uint8)layout->rgba;
+  TextLayout::Line line = {};
+  line.begin = begin;
+  line.first_instance = array_size(*instances);
+  *newline = false;
+  float pen_x = 0;
+  int prev_glyph_index = -1;
+  const char *wrap = nullptr; // past the last run of spaces
+  uint32 wrap_num_instances = 0;
+  float wrap_width = 0;
+  const char *str = text + begin;
+  const char *end = text + text_len;
+  while (str < end) {
+    if (*str == '\n') {
+      str += 1;
+      *newline = true;
+      break;
+    }
+    if (*str == ' ') {
+      Program::Fonts::GlyphMetrics metrics = get_font_glyph_metrics(face, ' ');
+      if (prev_glyph_index >= 0) {
+        pen_x += get_font_kern_advance(face, prev_glyph_index, metrics.glyph_index) * font->scale_factor;
+      }
+      prev_glyph_index = metrics.glyph_index;
+      if (wrap != str) { // first space of a run, the line would end before it
+        wrap_width = pen_x;
+        wrap_num_instances = array_size(*instances) - line.first_instance;
+      }
+      str += 1;
+      wrap = str;
+      pen_x += metrics.advance * font->scale_factor;
+      continue;
+    }
+    const char *word_end = str + 1;
+    while (word_end < end && *word_end != ' ' && *word_end != '\n' && word_end - str < FONT_SHAPED_RUN_MAX_BYTES) {
+      word_end += 1;
+    }
+    while (word_end < end && ((uchar)*word_end & 0xc0) == 0x80) { // not in the middle of a char
+      word_end += 1;
+    }
+    const Program::Fonts::ShapedRun *run = shape_text_run(fonts, layout->font, str, (uint32)(word_end - str));
+    uint32 num_glyphs = array_size(run->glyphs);
+    if (prev_glyph_index >= 0 && num_glyphs > 0) {
+      pen_x += get_font_kern_advance(face, prev_glyph_index, run->glyphs[0].glyph_index) * font->scale_factor;
+    }
+    const char *line_end = nullptr;
+    for (uint32 i = 0; i < num_glyphs; ++i) {
+      const Program::Fonts::ShapedGlyph *shaped = &run->glyphs[i];
+      bool cluster_begin = i == 0 || shaped->cluster != run->glyphs[i - 1].cluster;
+      if (cluster_begin && layout->max_width > 0 && pen_x + shaped->x + shaped->advance > layout->max_width) {
+        if (wrap) {
+          array_resize(instances, line.first_instance + wrap_num_instances);
+          line.width = wrap_width;
+          line_end = wrap;
+          break;
+        }
+        if (str + shaped->cluster > text + begin) {
+          line_end = str + shaped->cluster;
+          break;
+        }
+      }
+      Program::Fonts::Glyph glyph;
+      if (get_font_glyph(fonts, layout->font, shaped->codepoint, &glyph)) {
+        instance.x = text_vertex_coord(layout->x + pen_x + shaped->x);
+        instance.y = (int16)(line_y + text_vertex_coord(shaped->y));
+        instance.slot = (uint16)glyph.slot;
+        array_push(instances, instance);
+      }
+      if (shaped->advance > 0) {
+        line.width = pen_x + shaped->x + shaped->advance;
+      }
+    }
+    if (line_end) {
+      str = line_end;
+      break;
+    }
+    if (num_glyphs > 0) {
+      prev_glyph_index = run->glyphs[num_glyphs - 1].glyph_index;
+    }
+    pen_x += run->width;
+    str = word_end;
   }
-  font->scale_factor = stbtt_ScaleForPixelHeight(&font->info, 64);
-  stbtt_pack_context spc;
-  byte *pixels = MALLOC(byte, 1024 * 1024);
-  if (!stbtt_PackBegin(&spc, pixels, 1024, 1024, 0, 0, nullptr)) {
-    LOGF("stb_truetype PackBegin error");
-    return false;
+  line.end = (uint32)(str - text);
+  line.num_instances = array_size(*instances) - line.first_instance;
+  line.num_instance_slots = (line.num_instances + TEXT_LAYOUT_LINE_SPARE_SLOTS) / TEXT_LAYOUT_LINE_SPARE_SLOTS * TEXT_LAYOUT_LINE_SPARE_SLOTS;
+  array_resize(instances, line.first_instance + line.num_instance_slots);
+  memset(&(*instances)[line.first_instance + line.num_instances], 0, (line.num_instance_slots - line.num_instances) * sizeof(GlyphInstance));
+  return line;
+}
+
+// decodes text from begin on for about TEXT_LAYOUT_PREFETCH_BYTES and rasterizes the glyphs missing from the atlas
+// in one batch. returns where it stopped
+uint32 prefetch_text_glyphs(Program::Fonts *fonts, uint32 font, const char *text, uint32 text_len, uint32 begin) {
+  uint32 *codepoints = nullptr;
+  DEFER(delete_array(codepoints));
+  const char *end = text + min(text_len, begin + TEXT_LAYOUT_PREFETCH_BYTES);
+  while (end < text + text_len && ((uchar)*end & 0xc0) == 0x80) { // not in the middle of a char
+    end += 1;
   }
-  stbtt_PackSetOversampling(&spc, 2, 2);
-  stbtt_packedchar *packed_chars = MALLOC(stbtt_packedchar, 95);
-  if (!stbtt_PackFontRange(&spc, font_buf, 0, 64, 32, 95, packed_chars)) {
-    LOGF("stb_truetype PackFontRange error");
-    return false;
+  utf8_decode_to_array(text + begin, end, &codepoints);
+  prefetch_font_glyphs(fonts, font, codepoints, array_size(codepoints));
+  return (uint32)(end - text);
+}
+
+// lays out text[lines[first_line].begin, text_len) again and keeps the lines before first_line, an empty layout is
+// laid out from the start. stops at line_limit lines. returns false if the atlas generation changed on the way, the
+// layout is stale then
+bool layout_text(Program::Fonts *fonts, TextLayout *layout, const char *text, uint32 text_len, uint32 first_line = 0) {
+  uint32 atlas_generation = fonts->atlas_generation;
+  uint32 begin = 0;
+  if (first_line < array_size(layout->lines)) {
+    begin = layout->lines[first_line].begin;
+    array_resize(&layout->instances, layout->lines[first_line].first_instance);
+    array_resize(&layout->lines, first_line);
+  } else {
+    assert(first_line == 0);
+    array_clear(layout->lines);
+    array_clear(layout->instances);
+  }
+  layout->truncated = false;
+  uint32 prefetched = begin;
+  for (bool newline = true; newline || begin < text_len;) { // an empty text still has its line
+    if (layout->line_limit && array_size(layout->lines) >= layout->line_limit) {
+      layout->truncated = true;
+      break;
+    }
+    if (begin >= prefetched && begin < text_len) {
+      prefetched = prefetch_text_glyphs(fonts, layout->font, text, text_len, begin);
+    }
+    TextLayout::Line line = layout_text_line(fonts, layout, text, text_len, begin, array_size(layout->lines), &layout->instances, &newline);
+    array_push(&layout->lines, line);
+    begin = line.end;
   }
-  stbtt_PackEnd(&spc);
+  return fonts->atlas_generation == atlas_generation;
+}
 
-  font->atlas = pixels;
-  font->atlas_w = 1024;
-  font->atlas_h = 1024;
-  font->packed_chars = packed_chars;
-  font->num_packed_chars = 95;
-  return true;
+// text had bytes [edit_begin, edit_old_end) replaced with the ones now at [edit_begin, edit_new_end). lays out again
+// from the line before the edit, since a deletion can pull a word back onto it, until a line breaks where an old
+// line broke past the edit. the old lines from there on only move. the new lines go in the instance slots of the old
+// ones if they fit, and only the lines after move in the instances when they do not, or when the line count changed.
+// [*dirty_begin, *dirty_end) gets the instances changed. returns false like layout_text
+bool relayout_text(Program::Fonts *fonts, TextLayout *layout, const char *text, uint32 text_len,
+                   uint32 edit_begin, uint32 edit_old_end, uint32 edit_new_end, uint32 *dirty_begin, uint32 *dirty_end) {
+  uint32 num_lines = array_size(layout->lines);
+  if (num_lines == 0) {
+    *dirty_begin = 0;
+    bool ok = layout_text(fonts, layout, text, text_len);
+    *dirty_end = array_size(layout->instances);
+    return ok;
+  }
+  if (layout->truncated && edit_begin > layout->lines[num_lines - 1].end) { // past what is laid out
+    *dirty_begin = *dirty_end = 0;
+    return true;
+  }
+  uint32 atlas_generation = fonts->atlas_generation;
+  int32 delta = (int32)edit_new_end - (int32)edit_old_end;
+  uint32 first = 0; // last line beginning at or before the edit
+  for (uint32 lo = 0, hi = num_lines; lo < hi;) {
+    uint32 mid = (lo + hi) / 2;
+    if (layout->lines[mid].begin <= edit_begin) {
+      first = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  while (first > 0 && text[layout->lines[first].begin - 1] != '\n') {
+    bool mid_word = text[layout->lines[first].begin - 1] != ' '; // the word started a line further up
+    first -= 1;
+    if (!mid_word) {
+      break;
+    }
+  }
+  TextLayout::Line *new_lines = layout->staged_lines;
+  GlyphInstance *new_instances = layout->staged_instances;
+  array_clear(new_lines);
+  array_clear(new_instances);
+  DEFER(layout->staged_lines = new_lines; layout->staged_instances = new_instances);
+  uint32 last = num_lines - 1; // last old line replaced
+  uint32 begin = layout->lines[first].begin;
+  uint32 prefetched = begin;
+  uint32 line_limit = layout->line_limit ? max(layout->line_limit, num_lines) : 0;
+  bool converged = false;
+  bool truncated = false;
+  for (bool newline = true; newline || begin < text_len;) {
+    if (line_limit && first + array_size(new_lines) >= line_limit) {
+      truncated = true;
+      break;
+    }
+    if (begin >= prefetched && begin < text_len) {
+      prefetched = prefetch_text_glyphs(fonts, layout->font, text, text_len, begin);
+    }
+    TextLayout::Line line = layout_text_line(fonts, layout, text, text_len, begin, first + array_size(new_lines), &new_instances, &newline);
+    array_push(&new_lines, line);
+    begin = line.end;
+    if (begin >= edit_new_end && (newline || begin < text_len)) {
+      uint32 old_begin = (uint32)((int32)begin - delta); // where the next line begins in the old text
+      uint32 next = first + 1;
+      while (next < num_lines && layout->lines[next].begin < old_begin) {
+        next += 1;
+      }
+      if (next < num_lines && layout->lines[next].begin == old_begin && old_begin >= edit_old_end) {
+        last = next - 1;
+        converged = true;
+        break;
+      }
+    }
+  }
+  if (!converged) {
+    layout->truncated = truncated;
+  }
+  uint32 num_new_lines = array_size(new_lines);
+  uint32 num_new_instances = array_size(new_instances);
+  uint32 span_begin = layout->lines[first].first_instance;
+  uint32 span_end = layout->lines[last].first_instance + layout->lines[last].num_instance_slots;
+  uint32 num_tail_lines = num_lines - last - 1;
+  int32 line_delta = (int32)(first + num_new_lines) - (int32)(last + 1);
+  int32 instance_delta = 0;
+  if (num_new_instances <= span_end - span_begin) { // the last new line takes the spare slots, the tail stays put
+    new_lines[num_new_lines - 1].num_instance_slots += span_end - span_begin - num_new_instances;
+    array_resize(&new_instances, span_end - span_begin);
+    memset(&new_instances[num_new_instances], 0, (span_end - span_begin - num_new_instances) * sizeof(GlyphInstance));
+  } else {
+    instance_delta = (int32)num_new_instances - (int32)(span_end - span_begin);
+    uint32 num_instances = array_size(layout->instances);
+    array_resize(&layout->instances, num_instances + instance_delta);
+    memmove(&layout->instances[span_end + instance_delta], &layout->instances[span_end], (num_instances - span_end) * sizeof(GlyphInstance));
+  }
+  memcpy(&layout->instances[span_begin], new_instances, array_size(new_instances) * sizeof(GlyphInstance));
+  for (uint32 i = 0; i < num_new_lines; ++i) {
+    new_lines[i].first_instance += span_begin;
+  }
+  if (line_delta > 0) {
+    array_resize(&layout->lines, num_lines + line_delta);
+  }
+  memmove(&layout->lines[first + num_new_lines], &layout->lines[last + 1], num_tail_lines * sizeof(TextLayout::Line));
+  if (line_delta < 0) {
+    array_resize(&layout->lines, num_lines + line_delta);
+  }
+  memcpy(&layout->lines[first], new_lines, num_new_lines * sizeof(TextLayout::Line));
+  auto *font = &fonts->fonts[layout->font];
+  for (uint32 i = first + num_new_lines; i < first + num_new_lines + num_tail_lines; ++i) {
+    TextLayout::Line *line = &layout->lines[i];
+    line->begin += delta;
+    line->end += delta;
+    line->first_instance += instance_delta;
+    if (line_delta != 0) { // baselines moved, marks keep their offset from them
+      int16 old_y = text_vertex_coord(font->ascent + (i - line_delta) % font->page_lines * font->line_height);
+      int16 y = text_vertex_coord(font->ascent + i % font->page_lines * font->line_height);
+      for (uint32 j = 0; j < line->num_instances; ++j) {
+        layout->instances[line->first_instance + j].y += y - old_y;
+      }
+    }
+  }
+  *dirty_begin = span_begin;
+  *dirty_end = (instance_delta != 0 || line_delta != 0) ? array_size(layout->instances) : span_end;
+  return fonts->atlas_generation == atlas_generation;
+}
+
+// what the glyphs vertex shader does, for checking instances without a gpu. verts gets 4 per instance, relative to
+// the origin the instances are drawn at
+void expand_glyph_instances(Program::Fonts *fonts, const GlyphInstance *instances, uint32 num_instances, TextVertex *verts) {
+  float ipw = 1.0f / fonts->atlas_w;
+  float iph = 1.0f / fonts->atlas_h;
+  for (uint32 i = 0; i < num_instances; ++i) {
+    const GlyphInstance *instance = &instances[i];
+    const Program::Fonts::GlyphTableEntry *entry = &fonts->glyph_table[instance->slot];
+    float scale = (float)instance->scale / GLYPH_INSTANCE_SCALE_ONE;
+    float x = (float)instance->x / TEXT_VERTEX_SUBPIXELS;
+    float y = (float)instance->y / TEXT_VERTEX_SUBPIXELS;
+    uint32 rgba = (uint32)instance->r << 24 | (uint32)instance->g << 16 | (uint32)instance->b << 8 | instance->a;
+    put_text_quad(&verts[i * 4], x + entry->xoff * scale, y + entry->yoff * scale, x + entry->xoff2 * scale, y + entry->yoff2 * scale,
+                  entry->x0 * ipw, entry->y0 * iph, entry->x1 * ipw, entry->y1 * iph, rgba);
+  }
+}
+
+// uploads the chunks holding instances [first, end), adding chunks as they grow. a chunk is orphaned and specified
+// again whole from the staging copy rather than patched, so a draw still reading it from an earlier frame never makes
+// the upload wait
+void upload_glyph_instance_chunks(GLuint **chunks, const GlyphInstance *instances, uint32 num_instances, uint32 first, uint32 end) {
+  uint32 num_chunks = (num_instances + TEXT_INSTANCE_CHUNK_INSTANCES - 1) / TEXT_INSTANCE_CHUNK_INSTANCES;
+  while (array_size(*chunks) < num_chunks) {
+    GLuint chunk;
+    glGenBuffers(1, &chunk);
+    array_push(chunks, chunk);
+  }
+  end = min(end, num_instances);
+  for (uint32 chunk = first / TEXT_INSTANCE_CHUNK_INSTANCES; first < end && chunk * TEXT_INSTANCE_CHUNK_INSTANCES < end; ++chunk) {
+    uint32 chunk_first = chunk * TEXT_INSTANCE_CHUNK_INSTANCES;
+    uint32 chunk_num_instances = min(num_instances - chunk_first, (uint32)TEXT_INSTANCE_CHUNK_INSTANCES);
+    glBindBuffer(GL_ARRAY_BUFFER, (*chunks)[chunk]);
+    glBufferData(GL_ARRAY_BUFFER, TEXT_INSTANCE_CHUNK_INSTANCES * sizeof(GlyphInstance), nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, chunk_num_instances * sizeof(GlyphInstance), &instances[chunk_first]);
+  }
+}
+
+void upload_on_screen_text_instances(Program *program, uint32 first, uint32 end) {
+  auto *text = &program->on_screen_text;
+  upload_glyph_instance_chunks(&text->gl_instance_chunks, text->layout.instances, array_size(text->layout.instances), first, end);
+  text->num_instances_uploaded = array_size(text->layout.instances);
+}
+
+// the chunks hold instances in order, a run of them crossing a chunk boundary goes in a draw per chunk
+void draw_glyph_instance_chunks(Program::OpenGLES::Shaders::Glyphs *shader, const GLuint *chunks, uint32 first, uint32 count) {
+  for (uint32 end = first + count; first < end;) {
+    uint32 chunk = first / TEXT_INSTANCE_CHUNK_INSTANCES;
+    uint32 n = min(end, (chunk + 1) * TEXT_INSTANCE_CHUNK_INSTANCES) - first;
+    uintptr_t offset = (first - chunk * TEXT_INSTANCE_CHUNK_INSTANCES) * sizeof(GlyphInstance);
+    glBindBuffer(GL_ARRAY_BUFFER, chunks[chunk]);
+    glVertexAttribPointer(shader->attrib_pen, 2, GL_SHORT, GL_FALSE, sizeof(GlyphInstance), (void *)(offset + offsetof(GlyphInstance, x)));
+    glVertexAttribPointer(shader->attrib_slot_scale, 2, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(GlyphInstance), (void *)(offset + offsetof(GlyphInstance, slot)));
+    glVertexAttribPointer(shader->attrib_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GlyphInstance), (void *)(offset + offsetof(GlyphInstance, r)));
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n);
+    first += n;
+  }
+}
+
+// glyph table on unit 1 and atlas on unit 0, with the glyphs that went in since the last draw
+void bind_font_textures(Program::Fonts *fonts) {
+  glActiveTexture(GL_TEXTURE1);
+  update_font_glyph_table(fonts);
+  glBindTexture(GL_TEXTURE_2D, fonts->glyph_table_gl_texture_id);
+  glActiveTexture(GL_TEXTURE0);
+  update_font_atlas_mipmaps(fonts);
+  glBindTexture(GL_TEXTURE_2D, fonts->atlas_gl_texture_id);
+}
+
+// for drawing glyph instances onto the whole surface, see draw_text_layout_lines
+Program::OpenGLES::Shaders::Glyphs *use_glyphs_shader(Program *program) {
+  auto *fonts = &program->fonts;
+  auto *shader = fonts->sdf ? &program->opengl_es.shaders.glyphs_sdf : &program->opengl_es.shaders.glyphs;
+  int width = program->opengl_es.surface_width;
+  int height = program->opengl_es.surface_height;
+  glUseProgram(shader->id);
+  ORTHO_PROJECTION_MAT(ortho_mat, 0, (float)(width * TEXT_VERTEX_SUBPIXELS), (float)(height * TEXT_VERTEX_SUBPIXELS), 0, -1, 1);
+  glUniformMatrix4fv(shader->uniform_mvp_mat, 1, GL_FALSE, ortho_mat);
+  glUniform2f(shader->uniform_atlas_size, (float)fonts->atlas_w, (float)fonts->atlas_h);
+  glUniform1f(shader->uniform_pen_units_per_pixel, (float)TEXT_VERTEX_SUBPIXELS);
+  glUniform1i(shader->uniform_glyph_table, 1);
+  glUniform1i(shader->uniform_tex, 0);
+  bind_font_textures(fonts);
+  return shader;
+}
+
+// lines [first_line, end_line) of a layout whose instances are in chunks, with the top left of the layout space at
+// x, y on the surface. a draw per page, each with its own origin
+void draw_text_layout_lines(Program::Fonts *fonts, Program::OpenGLES::Shaders::Glyphs *shader, const TextLayout *layout,
+                            const GLuint *chunks, uint32 first_line, uint32 end_line, float x, float y) {
+  if (first_line >= end_line) {
+    return;
+  }
+  auto *font = &fonts->fonts[layout->font];
+  if (fonts->sdf) {
+    float raster_pixels_per_screen_pixel = font->raster_size / font->size;
+    glUniform1f(shader->uniform_smoothing, 0.5f * raster_pixels_per_screen_pixel * (128.0f / FONT_SDF_SPREAD) / 255.0f);
+  }
+  GLuint attribs[] = {shader->attrib_pen, shader->attrib_slot_scale, shader->attrib_color};
+  for (GLuint attrib : attribs) {
+    glEnableVertexAttribArray(attrib);
+    glVertexAttribDivisor(attrib, 1);
+  }
+  for (uint32 line = first_line; line < end_line;) {
+    uint32 page = line / font->page_lines;
+    uint32 page_end_line = min(end_line, (page + 1) * font->page_lines);
+    uint32 first_instance = layout->lines[line].first_instance;
+    auto *last = &layout->lines[page_end_line - 1];
+    uint32 num_instances = last->first_instance + last->num_instance_slots - first_instance;
+    float page_y = y + layout->y + page * font->page_lines * font->line_height;
+    glUniform2f(shader->uniform_origin, x * TEXT_VERTEX_SUBPIXELS, page_y * TEXT_VERTEX_SUBPIXELS);
+    draw_glyph_instance_chunks(shader, chunks, first_instance, num_instances);
+    line = page_end_line;
+  }
+  for (GLuint attrib : attribs) {
+    glVertexAttribDivisor(attrib, 0);
+    glDisableVertexAttribArray(attrib);
+  }
+}
+
+// the block starts 250 pixels down and wraps at the surface width, call again when that changes
+void reset_on_screen_text_layout(Program *program) {
+  auto *layout = &program->on_screen_text.layout;
+  array_clear(layout->lines);
+  array_clear(layout->instances);
+  layout->x = 0;
+  layout->y = 250;
+  layout->max_width = (float)program->opengl_es.surface_width;
+  layout->rgba = 0x00ff00ff;
+  program->on_screen_text.num_instances_uploaded = 0;
+}
+
+// lines [*first, *end) overlap layout space rows [top, bottom). lines all have the font's line height, so their boxes
+// follow from their index
+void get_visible_text_lines(Program::Fonts *fonts, TextLayout *layout, float top, float bottom, uint32 *first, uint32 *end) {
+  float line_height = fonts->fonts[layout->font].line_height;
+  uint32 num_lines = array_size(layout->lines);
+  *first = (uint32)min(max(0.0f, floorf((top - layout->y) / line_height)), (float)num_lines);
+  *end = (uint32)min(max(0.0f, ceilf((bottom - layout->y) / line_height)), (float)num_lines);
+  *end = max(*first, *end);
+}
+
+// lines down to a page past the bottom of the surface, the rest is laid out as it scrolls into view
+uint32 get_on_screen_text_line_limit(Program *program) {
+  auto *text = &program->on_screen_text;
+  float line_height = program->fonts.fonts[text->layout.font].line_height;
+  float bottom = text->scroll_y + program->opengl_es.surface_height - text->layout.y;
+  return (uint32)max(0.0f, ceilf(bottom / line_height)) + TEXT_LAYOUT_PAGE_LINES;
+}
+
+// the atlas evicting halfway through makes the instances before it stale, so go again until a pass gets through
+// without it
+void rebuild_on_screen_text_instances(Program *program) {
+  auto *fonts = &program->fonts;
+  auto *text = &program->on_screen_text;
+  for (int pass = 0; pass < 8; ++pass) {
+    reset_on_screen_text_layout(program);
+    text->layout.font_atlas_generation = fonts->atlas_generation;
+    text->layout.line_limit = get_on_screen_text_line_limit(program);
+    if (layout_text(fonts, &text->layout, text->text, str_len(text->text))) {
+      upload_on_screen_text_instances(program, 0, array_size(text->layout.instances));
+      return;
+    }
+  }
+  upload_on_screen_text_instances(program, 0, array_size(text->layout.instances));
+  LOGW("font atlas cannot hold every glyph of the on screen text at once");
+}
+
+// chars is utf-8 and may be any length. the lines around the edit are laid out again until they break where they
+// did before, and only the instances that changed are uploaded, with a single buffer call. a glyph eviction
+// invalidates the instances already in the buf so they are all rebuilt from the text
+void replace_on_screen_text(Program *program, uint32 begin, uint32 end, const char *chars) {
+  auto *fonts = &program->fonts;
+  auto *text = &program->on_screen_text;
+  auto *layout = &text->layout;
+  uint32 chars_len = strlen(chars);
+  str_splice(&text->text, begin, end, chars, chars_len);
+  if (!fonts->fonts) { // still loading, finish_font_load lays it out
+    return;
+  }
+  uint32 dirty_begin, dirty_end;
+  if (layout->font_atlas_generation != fonts->atlas_generation ||
+      !relayout_text(fonts, layout, text->text, str_len(text->text), begin, end, begin + chars_len, &dirty_begin, &dirty_end)) {
+    rebuild_on_screen_text_instances(program);
+    return;
+  }
+  upload_on_screen_text_instances(program, dirty_begin, dirty_end);
+}
+
+void add_chars_to_on_screen_text(Program *program, const char *chars) {
+  uint32 len = str_len(program->on_screen_text.text);
+  replace_on_screen_text(program, len, len, chars);
+}
+
+// backspace, takes the continuation bytes of a multibyte char with it
+void delete_last_char_of_on_screen_text(Program *program) {
+  const char *text = program->on_screen_text.text;
+  uint32 len = str_len(text);
+  if (len == 0) {
+    return;
+  }
+  uint32 begin = len - 1;
+  while (begin > 0 && ((uchar)text[begin] & 0xc0) == 0x80) {
+    begin -= 1;
+  }
+  replace_on_screen_text(program, begin, len, "");
 }
 
-void init_font_atlas_texture(Program::Font *font) {
-  glGenTextures(1, &font->atlas_gl_texture_id);
-  glBindTexture(GL_TEXTURE_2D, font->atlas_gl_texture_id);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, font->atlas_w, font->atlas_h, 0, GL_ALPHA, GL_UNSIGNED_BYTE, font->atlas);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+// lays out the lines that scrolled into view, if the layout stopped short of them
+void extend_on_screen_text_layout(Program *program) {
+  auto *fonts = &program->fonts;
+  auto *text = &program->on_screen_text;
+  auto *layout = &text->layout;
+  if (!fonts->fonts || !layout->truncated) {
+    return;
+  }
+  uint32 line_limit = get_on_screen_text_line_limit(program);
+  if (array_size(layout->lines) >= line_limit) {
+    return;
+  }
+  uint32 last_line = array_size(layout->lines) - 1;
+  uint32 first_instance = layout->lines[last_line].first_instance;
+  layout->line_limit = line_limit;
+  if (layout->font_atlas_generation != fonts->atlas_generation ||
+      !layout_text(fonts, layout, text->text, str_len(text->text), last_line)) {
+    rebuild_on_screen_text_instances(program);
+    return;
+  }
+  upload_on_screen_text_instances(program, first_instance, array_size(layout->instances));
 }
 
-void add_char_to_on_screen_text_verts_buf(Program *program, char c) {
+// dy in pixels, positive moves the text up. stops at the top and at the end of the text
+void scroll_on_screen_text(Program *program, float dy) {
   auto *text = &program->on_screen_text;
-  if (text->gl_verts_buf_id == 0) {
-    glGenBuffers(1, &text->gl_verts_buf_id);
-    glBindBuffer(GL_ARRAY_BUFFER, text->gl_verts_buf_id);
-    glBufferData(GL_ARRAY_BUFFER, 1024 * 16, nullptr, GL_STATIC_DRAW);
-    text->gl_verts_buf_size = 1024 * 16;
-    text->gl_verts_buf_size_in_use = 0;
-  }
-  int c_size = 36 * 6;
-  if ((text->gl_verts_buf_size - text->gl_verts_buf_size_in_use) < c_size) {
-    uint32 new_size = text->gl_verts_buf_size * 2;
-    GLuint new_buf;
-    glGenBuffers(1, &new_buf);
-    glBindBuffer(GL_COPY_WRITE_BUFFER, new_buf);
-    glBufferData(GL_COPY_WRITE_BUFFER, new_size, nullptr, GL_STATIC_COPY);
-    glBindBuffer(GL_COPY_READ_BUFFER, text->gl_verts_buf_id);
-    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, text->gl_verts_buf_size);
-    glDeleteBuffers(1, &text->gl_verts_buf_id);
-    text->gl_verts_buf_id = new_buf;
-    text->gl_verts_buf_size = new_size;
-    LOGI("on screen text verts buf new size %d", text->gl_verts_buf_size);
-  }
-  auto *font_data = &program->font;
-  int ascent, descent, line_gap;
-  stbtt_GetFontVMetrics(&font_data->info, &ascent, &descent, &line_gap);
-  float scale = font_data->scale_factor;
-  ascent *= scale;
-  descent *= scale;
-  line_gap *= scale;
-  int vertical_advance = ascent - descent + line_gap;
-  int surface_width = program->opengl_es.surface_width;
-
-  glBindBuffer(GL_ARRAY_BUFFER, text->gl_verts_buf_id);
-  byte* buf_ptr = (byte *)glMapBufferRange(GL_ARRAY_BUFFER, text->gl_verts_buf_size_in_use, c_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
-  DEFER(glUnmapBuffer(GL_ARRAY_BUFFER));
-
-  stbtt_aligned_quad quad;
-  stbtt_GetPackedQuad(font_data->packed_chars, font_data->atlas_w, font_data->atlas_h, c - ' ', &text->pen_pos_x, &text->pen_pos_y, &quad, 0);
-  float width = quad.x1 - quad.x0;
-  float height = quad.y1 - quad.y0;
-  QUAD_VERTS_XYZ_RGBA_ST(quad_verts_buf, quad.x0, quad.y1, 0, width, -height, 0, 1, 0, 1, quad.s0, quad.t1, quad.s1, quad.t0);
-  memcpy(buf_ptr, quad_verts_buf, sizeof(quad_verts_buf));
-  text->gl_verts_buf_size_in_use += c_size;
+  text->scroll_y = max(0.0f, text->scroll_y + dy);
+  extend_on_screen_text_layout(program);
+  if (program->fonts.fonts) {
+    float bottom = text->layout.y + array_size(text->layout.lines) * program->fonts.fonts[text->layout.font].line_height;
+    text->scroll_y = max(0.0f, min(text->scroll_y, bottom - program->opengl_es.surface_height));
+  }
+}
+
+uint64 hash_text_label(const char *text, uint32 len, uint32 font, float max_width, uint32 rgba) {
+  uint32 max_width_bits;
+  memcpy(&max_width_bits, &max_width, sizeof(max_width_bits));
+  return hash_key(hash_text_run(font, text, len) ^ hash_key((uint64)max_width_bits << 32 | rgba));
+}
+
+// lays the label out from its text and uploads all of it. the atlas evicting on the way makes it go again, like
+// rebuild_on_screen_text_instances
+void rebuild_text_label(Program::Fonts *fonts, TextLabel *label) {
+  auto *layout = &label->layout;
+  bool ok = false;
+  for (int pass = 0; pass < 8 && !ok; ++pass) {
+    layout->font_atlas_generation = fonts->atlas_generation;
+    ok = layout_text(fonts, layout, label->text, str_len(label->text));
+  }
+  upload_glyph_instance_chunks(&label->gl_instance_chunks, layout->instances, array_size(layout->instances), 0, array_size(layout->instances));
+  if (!ok) {
+    LOGW("font atlas cannot hold every glyph of a text label at once");
+  }
+}
+
+// text is utf-8. does nothing unless the text or style differ from what the label holds or its glyphs left the
+// atlas, so a static label can be set every frame for the cost of hashing its text. set labels before
+// use_glyphs_shader, the glyph table only goes up then
+void set_text_label(Program::Fonts *fonts, TextLabel *label, const char *text, uint32 font, float max_width, uint32 rgba) {
+  uint32 len = strlen(text);
+  uint64 key = hash_text_label(text, len, font, max_width, rgba);
+  bool same = label->text && key == label->key && str_len(label->text) == len && !memcmp(label->text, text, len);
+  if (same && array_size(label->layout.lines) > 0 && label->layout.font_atlas_generation == fonts->atlas_generation) {
+    return;
+  }
+  if (!same) {
+    label->key = key;
+    str_set_c(&label->text, text);
+    label->layout.font = font;
+    label->layout.max_width = max_width;
+    label->layout.rgba = rgba;
+  }
+  if (fonts->fonts) { // otherwise the first draw after the font loads lays it out
+    rebuild_text_label(fonts, label);
+  }
+}
+
+// top left at x, y on the surface, pixels. a label laid out before the glyphs of another one evicted its own is laid
+// out again here, which costs a glyph table upload mid frame
+void draw_text_label(Program *program, Program::OpenGLES::Shaders::Glyphs *shader, TextLabel *label, float x, float y) {
+  auto *fonts = &program->fonts;
+  if (!fonts->fonts || !label->text) {
+    return;
+  }
+  if (array_size(label->layout.lines) == 0 || label->layout.font_atlas_generation != fonts->atlas_generation) {
+    rebuild_text_label(fonts, label);
+    shader = use_glyphs_shader(program); // the glyph table went up again, and the atlas may have grown
+  }
+  draw_text_layout_lines(fonts, shader, &label->layout, label->gl_instance_chunks, 0, array_size(label->layout.lines), x, y);
+}
+
+void delete_text_label(TextLabel *label) {
+  if (label->gl_instance_chunks) {
+    glDeleteBuffers(array_size(label->gl_instance_chunks), label->gl_instance_chunks); // no-op if the context is already gone
+  }
+  delete_array(label->gl_instance_chunks);
+  delete_str(label->text);
+  delete_text_layout(&label->layout);
+  *label = {};
+}
+
+void *font_load_proc(void *user_data) {
+  auto *load = (Program::FontLoad *)user_data;
+  atomic_store(&load->status, 2);
+  stbtt_fontinfo info;
+  if (!load->map_file(load, load->ttf_path, &load->ttf) || !stbtt_InitFont(&info, load->ttf.data, 0)) {
+    LOGW("cannot load font file %s", load->ttf_path);
+    unmap_file(&load->ttf);
+    atomic_store(&load->status, 4);
+    load->done(load);
+    return nullptr;
+  }
+  if (!load->sdf) { // the ascii glyphs go in through a baked atlas either way, so they never rasterize on the gl thread
+    const char *error = "not found";
+    if (load->baked_atlas_path && load->map_file(load, load->baked_atlas_path, &load->baked_atlas)) {
+      error = check_baked_font_atlas(load->baked_atlas.data, load->baked_atlas.len, load->ttf.data, load->ttf.len, load->size, FONT_ATLAS_SIZE, FONT_ATLAS_SIZE);
+    }
+    if (error) {
+      LOGI("baked font atlas %s: %s, baking it now", load->baked_atlas_path ? load->baked_atlas_path : "", error);
+      unmap_file(&load->baked_atlas);
+      size_t baked_atlas_len = 0;
+      load->baked_atlas.data = bake_font_atlas(load->ttf.data, load->ttf.len, load->size, FONT_ATLAS_SIZE, FONT_ATLAS_PADDING, 2,
+                                               [](size_t size) { return (void *)MALLOC(byte, size); },
+                                               [](void *ptr) { FREE(ptr); }, &baked_atlas_len);
+      load->baked_atlas.len = (uint32)baked_atlas_len;
+      load->baked_atlas.heap = true;
+    }
+  }
+  atomic_store(&load->status, 3);
+  load->done(load);
+  return nullptr;
+}
+
+// file reads, hashing and baking happen on a detached thread. done fires there when it is over, and the platform
+// gets finish_font_load called on the gl thread from it. text typed in the meantime is kept and drawn then
+void start_font_load(Program::FontLoad *load) {
+  atomic_store(&load->status, 0);
+  pthread_t thread;
+  if (pthread_create(&thread, nullptr, font_load_proc, load)) {
+    LOGW("cannot create font load thread");
+    atomic_store(&load->status, 1);
+    return;
+  }
+  pthread_detach(thread);
+}
+
+// on the gl thread once the load is done. returns false if there is still no font to draw text with
+bool finish_font_load(Program *program) {
+  auto *fonts = &program->fonts;
+  auto *load = &program->font_load;
+  if (atomic_load(&load->status) != 3) {
+    return false;
+  }
+  int face = add_font_face(fonts, &load->ttf);
+  if (face < 0) {
+    unmap_file(&load->baked_atlas);
+    return false;
+  }
+  program->on_screen_text.layout.font = add_font(fonts, face, load->size);
+  if (load->baked_atlas.data) {
+    install_baked_font_atlas(fonts, program->on_screen_text.layout.font, &load->baked_atlas); // uploads if the texture is up
+  }
+  reset_on_screen_text_layout(program);
+  if (fonts->atlas_gl_texture_id && str_len(program->on_screen_text.text) > 0) {
+    rebuild_on_screen_text_instances(program);
+  }
+  return true;
 }
 
 void render_font_atlas(Program *program) {
-  auto *font = &program->font;
+  auto *fonts = &program->fonts;
   auto *shader = &program->opengl_es.shaders.text;
   glUseProgram(shader->id);
-  ORTHO_PROJECTION_MAT(ortho_mat, -1, 1, 1, -1, -1, 1);
+  ORTHO_PROJECTION_MAT(ortho_mat, 0, TEXT_VERTEX_SUBPIXELS, TEXT_VERTEX_SUBPIXELS, 0, -1, 1); // unit quad
   glUniformMatrix4fv(shader->uniform_mvp_mat, 1, GL_FALSE, ortho_mat);
+  update_font_atlas_mipmaps(fonts);
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, font->atlas_gl_texture_id);
+  glBindTexture(GL_TEXTURE_2D, fonts->atlas_gl_texture_id);
   glUniform1i(shader->uniform_tex, 0);
 
-  QUAD_VERTS_XYZ_RGBA_ST(verts_buf, -1, -1, 0, 2, 2, 0, 1, 0, 1, 0, 0, 1, 1);
+  TextVertex verts[4];
+  put_text_quad(verts, 0, 0, 1, 1, 0, 0, 1, 1, 0x00ff00ff);
   GLuint gl_verts_buf;
   glGenBuffers(1, &gl_verts_buf);
   glBindBuffer(GL_ARRAY_BUFFER, gl_verts_buf);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(verts_buf), verts_buf, GL_STATIC_DRAW);
-
-  glEnableVertexAttribArray(shader->attrib_position);
-  glEnableVertexAttribArray(shader->attrib_color);
-  glEnableVertexAttribArray(shader->attrib_tcoord);
-  glVertexAttribPointer(shader->attrib_position, 3, GL_FLOAT, GL_FALSE, 36, (void *)0);
-  glVertexAttribPointer(shader->attrib_color, 4, GL_FLOAT, GL_FALSE, 36, (void *)12);
-  glVertexAttribPointer(shader->attrib_tcoord, 2, GL_FLOAT, GL_FALSE, 36, (void *)28);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
 
   glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT);
@@ -829,34 +3622,23 @@ void render_font_atlas(Program *program) {
   glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ZERO);
   int dh = (program->opengl_es.surface_height - program->opengl_es.surface_width) / 2;
   glViewport(0, dh, program->opengl_es.surface_width, program->opengl_es.surface_width);
-  glDrawArrays(GL_TRIANGLES, 0, 6);
+  draw_text_quads(&program->opengl_es, shader, gl_verts_buf, 1);
   gl_swap_buffers(&program->opengl_es);
-  glDisableVertexAttribArray(shader->attrib_position);
-  glDisableVertexAttribArray(shader->attrib_color);
-  glDisableVertexAttribArray(shader->attrib_tcoord);
+  glDeleteBuffers(1, &gl_verts_buf);
   glDisable(GL_BLEND);
 }
 
+// draws into the back buffer and leaves blending on, the platform draws its labels on top and swaps
 void render_on_screen_text(Program *program) {
-  auto *font = &program->font;
+  auto *fonts = &program->fonts;
   auto *text = &program->on_screen_text;
-  auto *shader = &program->opengl_es.shaders.text;
   int width = program->opengl_es.surface_width;
   int height = program->opengl_es.surface_height;
-  glUseProgram(shader->id);
-  ORTHO_PROJECTION_MAT(ortho_mat, 0, (float)width, (float)height, 0, -1, 1);
-  glUniformMatrix4fv(shader->uniform_mvp_mat, 1, GL_FALSE, ortho_mat);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, font->atlas_gl_texture_id);
-  glUniform1i(shader->uniform_tex, 0);
-
-  glBindBuffer(GL_ARRAY_BUFFER, text->gl_verts_buf_id);
-  glEnableVertexAttribArray(shader->attrib_position);
-  glEnableVertexAttribArray(shader->attrib_color);
-  glEnableVertexAttribArray(shader->attrib_tcoord);
-  glVertexAttribPointer(shader->attrib_position, 3, GL_FLOAT, GL_FALSE, 36, (void *)0);
-  glVertexAttribPointer(shader->attrib_color, 4, GL_FLOAT, GL_FALSE, 36, (void *)12);
-  glVertexAttribPointer(shader->attrib_tcoord, 2, GL_FLOAT, GL_FALSE, 36, (void *)28);
+  if (fonts->fonts && text->layout.font_atlas_generation != fonts->atlas_generation) { // a label evicted its glyphs
+    rebuild_on_screen_text_instances(program);
+  }
+  scroll_on_screen_text(program, 0); // the text may have got shorter, or the surface taller
+  auto *shader = use_glyphs_shader(program);
 
   glViewport(0, 0, width, height);
   glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -865,12 +3647,12 @@ void render_on_screen_text(Program *program) {
   glEnable(GL_BLEND);
   glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
   glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ZERO);
-  glDrawArrays(GL_TRIANGLES, 0, text->gl_verts_buf_size_in_use / 36);
-  gl_swap_buffers(&program->opengl_es);
-  glDisableVertexAttribArray(shader->attrib_position);
-  glDisableVertexAttribArray(shader->attrib_color);
-  glDisableVertexAttribArray(shader->attrib_tcoord);
-  glDisable(GL_BLEND);
+  uint32 first_line = 0;
+  uint32 end_line = 0;
+  if (fonts->fonts && text->num_instances_uploaded > 0) {
+    get_visible_text_lines(fonts, &text->layout, text->scroll_y, text->scroll_y + height, &first_line, &end_line);
+  }
+  draw_text_layout_lines(fonts, shader, &text->layout, text->gl_instance_chunks, first_line, end_line, 0, -text->scroll_y);
 }
 
 void *dns_lookup_proc(void *user_data) {
@@ -887,64 +3669,61 @@ void *dns_lookup_proc(void *user_data) {
   return nullptr;
 }
 
+// lookups is a list through next of MALLOCed lookups, each is FREEd once it finishes, or right away if its thread
+// cannot start
 void dns_lookup(Program::Network *network, Program::Network::DNSLookup *lookups) {
   Program::Network::DNSLookup *lookup = lookups;
   while (lookup) {
+    Program::Network::DNSLookup *next = lookup->next;
     atomic_store(&lookup->status, 0);
     pthread_t thread;
     if (pthread_create(&thread, nullptr, dns_lookup_proc, lookup)) {
-      atomic_store(&lookup->status, 1);
-    }
-    pthread_detach(thread);
-    lookup = lookup->next;
-  }
-  if (!network->dns_lookups) {
-    network->dns_lookups = lookups;
-  } else {
-    Program::Network::DNSLookup *lookup = network->dns_lookups;
-    while (lookup->next) {
-      lookup = lookup->next;
+      LOGW("cannot start dns lookup thread, domain name: %s", lookup->domain_name);
+      FREE(lookup);
+    } else {
+      pthread_detach(thread);
+      hash_map_insert(&network->dns_lookups, lookup->domain_name, lookup);
     }
-    lookup->next = lookups;
+    lookup = next;
   }
 }
 
-void finish_connection_attempt(Program *program, int attempt_index);
+#define HTTP_REQUEST_FORMAT "GET / HTTP/1.1\r\nHost: %s\r\n\r\n"
+#define HTTP_RESPONSE_SCRATCH_SIZE (16 * 1024) // the first read of a response, from the scratch arena
+
+void finish_connection_attempt(Program *program, Program::Network::ConnectionAttempt *ca);
 int connection_getopt_callback(int fd, int events, void* data);
 int connection_read_write_callback(int fd, int events, void* data);
 
 #ifdef __ANDROID__
 
-void start_connection_attempt(Program *program, int attempt_index) {
+// tries the addresses of ca from cur_addr on, until a connect succeeds or is in progress
+void start_connection_attempt(Program *program, Program::Network::ConnectionAttempt ca) {
   ALooper *alooper = program->app->looper;
-  Program::Network *network = &program->network;
-  Program::Network::ConnectionAttempt *ca = &network->connection_attempts[attempt_index];
-  ALooper_removeFd(alooper, ca->socket_fd);
-  close(ca->socket_fd);
-  while (ca->cur_addr) {
-    LOGD("trying create socket with addr, domain name %s", ca->domain_name);
-    int socket_fd = socket(ca->cur_addr->ai_family, ca->cur_addr->ai_socktype, ca->cur_addr->ai_protocol);
+  while (ca.cur_addr) {
+    LOGD("trying create socket with addr, domain name %s", ca.domain_name);
+    int socket_fd = socket(ca.cur_addr->ai_family, ca.cur_addr->ai_socktype, ca.cur_addr->ai_protocol);
     if (socket_fd != -1 && fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL, 0) & ~O_NONBLOCK) != -1) {
-      LOGD("successful create socket with addr, domain name %s", ca->domain_name);
-      ca->socket_fd = socket_fd;
+      LOGD("successful create socket with addr, domain name %s", ca.domain_name);
+      ca.socket_fd = socket_fd;
       break;
     }
-    LOGD("failure create socket with addr, domain name %s", ca->domain_name);
+    LOGD("failure create socket with addr, domain name %s", ca.domain_name);
     close(socket_fd);
-    ca->cur_addr = ca->cur_addr->ai_next;
+    ca.cur_addr = ca.cur_addr->ai_next;
   }
-  if (!ca->cur_addr) {
-    LOGD("cannot create socket, domain name %s", ca->domain_name);
-    freeaddrinfo(ca->addr_list);
-    array_swap_with_end_then_pop(network->connection_attempts, attempt_index);
+  if (!ca.cur_addr) {
+    LOGD("cannot create socket, domain name %s", ca.domain_name);
+    freeaddrinfo(ca.addr_list);
   } else {
-    int err = connect(ca->socket_fd, ca->cur_addr->ai_addr, ca->cur_addr->ai_addrlen);
+    int err = connect(ca.socket_fd, ca.cur_addr->ai_addr, ca.cur_addr->ai_addrlen);
     if (!err) {
-      LOGD("socket connected, domain name %s", ca->domain_name);
-      finish_connection_attempt(program, attempt_index);
+      LOGD("socket connected, domain name %s", ca.domain_name);
+      finish_connection_attempt(program, &ca);
     } else if (errno == EINPROGRESS) {
-      LOGD("socket connect in progress, domain name %s", ca->domain_name);
-      ALooper_addFd(alooper, ca->socket_fd, 0, ALOOPER_EVENT_OUTPUT, connection_getopt_callback, program);
+      LOGD("socket connect in progress, domain name %s", ca.domain_name);
+      hash_map_insert(&program->network.connection_attempts, ca.socket_fd, ca);
+      ALooper_addFd(alooper, ca.socket_fd, 0, ALOOPER_EVENT_OUTPUT, connection_getopt_callback, program);
     } else {
       LOGD("oops unhandled socket error(%d)", err);
       exit(1);
@@ -952,16 +3731,14 @@ void start_connection_attempt(Program *program, int attempt_index) {
   }
 }
 
-void finish_connection_attempt(Program *program, int attempt_index) {
+void finish_connection_attempt(Program *program, Program::Network::ConnectionAttempt *ca) {
   ALooper *alooper = program->app->looper;
-  Program::Network::ConnectionAttempt *ca = &program->network.connection_attempts[attempt_index];
   Program::Network::Connection conn = {};
   conn.socket_fd = ca->socket_fd;
   conn.domain_name = ca->domain_name;
   freeaddrinfo(ca->addr_list);
-  array_swap_with_end_then_pop(program->network.connection_attempts, attempt_index);
   ALooper_addFd(alooper, conn.socket_fd, 0, ALOOPER_EVENT_INPUT | ALOOPER_EVENT_OUTPUT, connection_read_write_callback, program);
-  array_push(&program->network.connections, conn);
+  hash_map_insert(&program->network.connections, conn.socket_fd, conn);
 }
 
 int dns_lookup_callback(int fd, int event, void* data) {
@@ -980,10 +3757,13 @@ int dns_lookup_callback(int fd, int event, void* data) {
       ca.domain_name = lookups[i]->domain_name;
       ca.addr_list = lookups[i]->response;
       ca.cur_addr = ca.addr_list;
-      array_push(&program->network.connection_attempts, ca);
-      start_connection_attempt(program, array_size(program->network.connection_attempts) - 1);
+      start_connection_attempt(program, ca);
+    }
+    Program::Network::DNSLookup **in_flight = hash_map_find(&program->network.dns_lookups, lookups[i]->domain_name);
+    if (in_flight && *in_flight == lookups[i]) { // not replaced by a later lookup of the same name
+      hash_map_remove(&program->network.dns_lookups, lookups[i]->domain_name);
     }
-    // TODO: remove lookups[i] from program->network->dns_lookups
+    FREE(lookups[i]);
   }
   return 1;
 }
@@ -991,50 +3771,50 @@ int dns_lookup_callback(int fd, int event, void* data) {
 int connection_getopt_callback(int fd, int event, void* data) {
   Program *program = (Program*)data;
   LOGD("connection getsockopt");
-  int i;
-  for (i = 0; i < array_size(program->network.connection_attempts); ++i) {
-    if (program->network.connection_attempts[i].socket_fd == fd) {
-      break;
-    }
-  }
-  assert(i < array_size(program->network.connection_attempts));
-  Program::Network::ConnectionAttempt ca = program->network.connection_attempts[i];
+  Program::Network::ConnectionAttempt ca;
+  bool found = hash_map_remove(&program->network.connection_attempts, fd, &ca);
+  assert(found);
   int err;
   socklen_t err_len = sizeof(err);
   getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
   if (!err) {
     LOGD("connection getsockopt succeed, domain name: %s", ca.domain_name);
-    finish_connection_attempt(program, i);
+    finish_connection_attempt(program, &ca);
   } else {
     LOGD("connection getsockopt failed, try next addr, domain name: %s", ca.domain_name);
+    ALooper_removeFd(program->app->looper, fd);
+    close(fd);
+    ca.socket_fd = -1;
     ca.cur_addr = ca.cur_addr->ai_next;
-    start_connection_attempt(program, i);
+    start_connection_attempt(program, ca);
   }
   return 1;
 }
 
 int connection_read_write_callback(int fd, int event, void* data) {
   Program *program = (Program*)data;
-  int i;
-  for (i = 0; i < array_size(program->network.connections); ++i) {
-    if (program->network.connections[i].socket_fd == fd) {
-      break;
-    }
-  }
-  assert(i < array_size(program->network.connections));
-  Program::Network::Connection conn = program->network.connections[i];
+  Program::Network::Connection *conn_ptr = hash_map_find(&program->network.connections, fd);
+  assert(conn_ptr);
+  Program::Network::Connection conn = *conn_ptr;
   if (event == ALOOPER_EVENT_INPUT) {
-    char response[2048];
-    int n = read(conn.socket_fd, response, sizeof(response));
-    response[n - 1] = '\0';
-    LOGI("\n>>>>>>>>>>>>>%s<<<<<<<<<<<<<<<<\n%s", conn.domain_name, response);
+    ARENA_SCOPE(&program->scratch_arena);
+    char *response = ARENA_ALLOC(&program->scratch_arena, char, HTTP_RESPONSE_SCRATCH_SIZE);
+    int n = response ? read(conn.socket_fd, response, HTTP_RESPONSE_SCRATCH_SIZE - 1) : -1;
+    if (n >= 0) {
+      response[n] = '\0';
+      LOGI("\n>>>>>>>>>>>>>%s<<<<<<<<<<<<<<<<\n%s", conn.domain_name, response);
+    }
     ALooper_removeFd(program->app->looper, conn.socket_fd);
     close(conn.socket_fd);
-    array_swap_with_end_then_pop(program->network.connections, i);
+    hash_map_remove(&program->network.connections, fd);
   } else if (event == ALOOPER_EVENT_OUTPUT) {
-    char request[256];
-    snprintf(request, sizeof(request), "GET / HTTP/1.1\r\nHost: %s\r\n\r\n", conn.domain_name);
-    int n = write(conn.socket_fd, request, strlen(request));
+    ARENA_SCOPE(&program->scratch_arena);
+    int request_len = snprintf(nullptr, 0, HTTP_REQUEST_FORMAT, conn.domain_name);
+    char *request = ARENA_ALLOC(&program->scratch_arena, char, request_len + 1);
+    if (request) {
+      snprintf(request, request_len + 1, HTTP_REQUEST_FORMAT, conn.domain_name);
+      write(conn.socket_fd, request, request_len);
+    }
     ALooper_addFd(program->app->looper, conn.socket_fd, 0, ALOOPER_EVENT_INPUT, connection_read_write_callback, program);
   }
   return 1;
@@ -0,0 +1,78 @@
+/* Copyright (C) 2015-2016 yang chen yngccc@gmail.com
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA. */
+
+// host side: bakes printable ascii of a ttf into the format of baked_font_atlas.h, so the app starts without
+// rasterizing anything. the parameters have to match the runtime bitmap atlas (FONT_ATLAS_SIZE, FONT_ATLAS_PADDING,
+// 2x2 oversampling), check_baked_font_atlas rejects the file otherwise.
+//
+// c++ -std=c++11 -O2 tools/bake_font_atlas.cpp -o bake_font_atlas
+// ./bake_font_atlas assets/fonts/open-sans/OpenSans-Regular.ttf assets/fonts/open-sans/OpenSans-Regular.atlas 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "../stb_rect_pack.h"
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "../stb_truetype.h"
+#include "../baked_font_atlas.h"
+
+#define ATLAS_SIZE 1024
+#define ATLAS_PADDING 1
+#define OVERSAMPLING 2
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s font.ttf out.atlas [pixel height, default 64]\n", argv[0]);
+    return 1;
+  }
+  float font_size = argc > 3 ? (float)atof(argv[3]) : 64.0f;
+
+  FILE *ttf_file = fopen(argv[1], "rb");
+  if (!ttf_file) {
+    fprintf(stderr, "cannot open %s\n", argv[1]);
+    return 1;
+  }
+  fseek(ttf_file, 0, SEEK_END);
+  long ttf_len = ftell(ttf_file);
+  fseek(ttf_file, 0, SEEK_SET);
+  unsigned char *ttf = (unsigned char *)malloc(ttf_len);
+  if (fread(ttf, 1, ttf_len, ttf_file) != (size_t)ttf_len) {
+    fprintf(stderr, "cannot read %s\n", argv[1]);
+    return 1;
+  }
+  fclose(ttf_file);
+
+  size_t baked_len;
+  unsigned char *baked = bake_font_atlas(ttf, ttf_len, font_size, ATLAS_SIZE, ATLAS_PADDING, OVERSAMPLING, malloc, free, &baked_len);
+  if (!baked) {
+    fprintf(stderr, "glyphs do not fit in a %dx%d atlas at %g pixels\n", ATLAS_SIZE, ATLAS_SIZE, font_size);
+    return 1;
+  }
+
+  FILE *out_file = fopen(argv[2], "wb");
+  if (!out_file || fwrite(baked, baked_len, 1, out_file) != 1 || fclose(out_file) != 0) {
+    fprintf(stderr, "cannot write %s\n", argv[2]);
+    return 1;
+  }
+  printf("baked %d glyphs at %gpx into %ux%u, %ld bytes\n", BAKED_FONT_ATLAS_NUM_CODEPOINTS, font_size, ATLAS_SIZE,
+         ((BakedFontAtlasHeader *)baked)->baked_h, (long)baked_len);
+  free(baked);
+  free(ttf);
+  return 0;
+}
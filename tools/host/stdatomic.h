@@ -0,0 +1,32 @@
+/* Copyright (C) 2015-2016 yang chen yngccc@gmail.com
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA. */
+
+// host side: the c11 <stdatomic.h> that shared.cpp uses, on top of std::atomic. the ndk and xcode clangs take the c
+// header in c++, host gcc does not
+
+#pragma once
+
+#include <atomic>
+
+#define _Atomic(T) std::atomic<T>
+
+using std::atomic_load;
+using std::atomic_store;
+using std::atomic_exchange;
+using std::atomic_compare_exchange_weak;
+using std::atomic_compare_exchange_strong;
+using std::atomic_fetch_add;
+using std::atomic_fetch_sub;
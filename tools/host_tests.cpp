@@ -0,0 +1,1348 @@
+/* Copyright (C) 2015-2016 yang chen yngccc@gmail.com
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA. */
+
+// host side: checks shared.cpp against reference implementations with random operations, and times it. no gl
+// context is ever made, gl calls go to libGLESv2 and do nothing. run from the repo root, some tests load fonts from
+// assets. a name after the mode runs only the tests or benchmarks whose name contains it.
+//
+// c++ -std=c++11 -g -O1 -fsanitize=address,undefined -Itools/host tools/host_tests.cpp -o host_tests -lGLESv2 -lpthread
+// ./host_tests
+// c++ -std=c++11 -O2 -Itools/host tools/host_tests.cpp -o host_bench -lGLESv2 -lpthread
+// ./host_bench bench
+
+#include "../shared.cpp"
+
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <unordered_map>
+#include <thread>
+#include <algorithm>
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); abort(); } } while (0)
+
+namespace {
+volatile uint64 bench_sink; // keeps benchmarked results alive
+
+template <typename F>
+double bench_ns_per_op(uint32 num_ops, F func) {
+  auto t0 = std::chrono::steady_clock::now();
+  func();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / num_ops;
+}
+
+void check_str(const char *str, const std::string &ref) {
+  CHECK(str_len(str) == ref.size());
+  if (str) {
+    CHECK(str_capacity(str) >= str_len(str));
+    CHECK(!memcmp(str, ref.c_str(), ref.size() + 1));
+  }
+}
+
+template <typename T>
+void check_array(const T *array, const std::vector<T> &ref) {
+  CHECK(array_size(array) == ref.size());
+  CHECK(array_capacity(array) >= array_size(array));
+  CHECK(ref.empty() || !memcmp(array, ref.data(), ref.size() * sizeof(T)));
+}
+
+// a program with just the fonts and the on screen text, on a 1080x1920 surface
+Program *new_text_program(float font_size) {
+  Program *program = CALLOC(Program, 1);
+  CHECK(init_fonts(&program->fonts));
+  FileMap ttf;
+  CHECK(map_file(&ttf, "assets/fonts/open-sans/OpenSans-Regular.ttf"));
+  program->on_screen_text.layout.font = add_font(&program->fonts, add_font_face(&program->fonts, &ttf), font_size);
+  init_font_atlas_texture(&program->fonts);
+  program->fonts.atlas_gl_texture_id = 1;
+  program->opengl_es.surface_width = 1080;
+  program->opengl_es.surface_height = 1920;
+  reset_on_screen_text_layout(program);
+  return program;
+}
+
+void delete_text_program(Program *program) {
+  delete_str(program->on_screen_text.text);
+  delete_text_layout(&program->on_screen_text.layout);
+  delete_array(program->on_screen_text.gl_instance_chunks);
+  delete_fonts(&program->fonts);
+  FREE(program);
+}
+
+// lines tile the text, wrap within max_width unless a single word is wider, and every non space char gets a glyph
+void check_wrapped_layout(const TextLayout *layout, const char *text) {
+  uint32 num_lines = array_size(layout->lines);
+  CHECK(num_lines >= 1 && layout->lines[0].begin == 0 && layout->lines[num_lines - 1].end == strlen(text));
+  uint32 num_instances = 0;
+  for (uint32 i = 0; i < num_lines; ++i) {
+    const TextLayout::Line *line = &layout->lines[i];
+    CHECK(i == 0 || line->begin == layout->lines[i - 1].end);
+    CHECK(line->first_instance == num_instances);
+    num_instances += line->num_instance_slots;
+    bool one_word = true;
+    for (uint32 b = line->begin; b + 1 < line->end; ++b) {
+      one_word = one_word && !(text[b] == ' ' && text[b + 1] != ' ');
+    }
+    CHECK(layout->max_width == 0 || one_word || line->width <= layout->max_width);
+  }
+  CHECK(num_instances == array_size(layout->instances));
+  uint32 num_glyphs = 0;
+  for (uint32 i = 0; i < num_lines; ++i) {
+    num_glyphs += layout->lines[i].num_instances;
+  }
+  uint32 num_visible_chars = 0;
+  for (const char *c = text; *c; ++c) {
+    num_visible_chars += *c != ' ' && *c != '\n';
+  }
+  CHECK(num_glyphs == num_visible_chars);
+}
+
+// a's lines are the first lines of b, down to the instances
+void check_layout_prefix(const TextLayout *a, const TextLayout *b) {
+  CHECK(array_size(a->lines) <= array_size(b->lines));
+  for (uint32 i = 0; i < array_size(a->lines); ++i) {
+    const TextLayout::Line *x = &a->lines[i];
+    const TextLayout::Line *y = &b->lines[i];
+    CHECK(x->begin == y->begin && x->end == y->end && x->num_instances == y->num_instances && x->width == y->width);
+    CHECK(!memcmp(&a->instances[x->first_instance], &b->instances[y->first_instance], x->num_instances * sizeof(GlyphInstance)));
+    uint32 next_instance = i + 1 < array_size(a->lines) ? a->lines[i + 1].first_instance : array_size(a->instances);
+    CHECK(x->first_instance + x->num_instance_slots == next_instance);
+    for (uint32 j = x->num_instances; j < x->num_instance_slots; ++j) {
+      CHECK(a->instances[x->first_instance + j].scale == 0);
+    }
+  }
+}
+
+void utf8_encode(uint32 c, std::string *out) {
+  if (c < 0x80) {
+    *out += (char)c;
+  } else if (c < 0x800) {
+    *out += (char)(0xc0 | c >> 6);
+    *out += (char)(0x80 | (c & 0x3f));
+  } else if (c < 0x10000) {
+    *out += (char)(0xe0 | c >> 12);
+    *out += (char)(0x80 | (c >> 6 & 0x3f));
+    *out += (char)(0x80 | (c & 0x3f));
+  } else {
+    *out += (char)(0xf0 | c >> 18);
+    *out += (char)(0x80 | (c >> 12 & 0x3f));
+    *out += (char)(0x80 | (c >> 6 & 0x3f));
+    *out += (char)(0x80 | (c & 0x3f));
+  }
+}
+
+// both decoders, one codepoint at a time and in bulk, agree on bytes and the bulk one is what it returns
+std::vector<uint32> utf8_decode_both(const std::string &bytes) {
+  std::vector<uint32> scalar;
+  const char *str = bytes.data();
+  const char *end = bytes.data() + bytes.size();
+  while (str < end) {
+    const char *prev = str;
+    scalar.push_back(utf8_decode(&str, end));
+    CHECK(str > prev && str <= end);
+  }
+  uint32 *bulk = nullptr;
+  array_push(&bulk, 7u); // appends after what is there
+  utf8_decode_to_array(bytes.data(), end, &bulk);
+  CHECK(array_size(bulk) == scalar.size() + 1 && bulk[0] == 7u);
+  CHECK(scalar.empty() || !memcmp(bulk + 1, scalar.data(), scalar.size() * sizeof(uint32)));
+  delete_array(bulk);
+  return scalar;
+}
+} // namespace
+
+void test_str_ops() {
+  std::mt19937 rng(3);
+  for (int iter = 0; iter < 3000; ++iter) {
+    char *str = nullptr;
+    std::string ref;
+    for (int op = 0; op < 100; ++op) {
+      switch (rng() % 11) {
+      case 0: {
+        char c = "ab/c"[rng() % 4];
+        str_cat(&str, c);
+        ref += c;
+      } break;
+      case 1: {
+        std::string more(rng() % 20, "ab/"[rng() % 3]);
+        str_cat_c(&str, more.c_str());
+        ref += more;
+      } break;
+      case 2: { // appending itself, the source moves with the realloc
+        str_cat(&str, str);
+        ref += ref;
+      } break;
+      case 3: {
+        if (!ref.empty()) {
+          uint32 offset = rng() % ref.size();
+          str_cat_c(&str, str + offset);
+          ref += ref.substr(offset);
+        }
+      } break;
+      case 4: {
+        uint32 n = rng() % (ref.size() + 1);
+        if (str) {
+          str_pop(str, n);
+          ref.resize(ref.size() - n);
+        }
+      } break;
+      case 5: {
+        if (str) {
+          str_pop_to_char(str, '/');
+          size_t slash = ref.rfind('/');
+          if (slash != std::string::npos) {
+            ref.resize(slash + 1);
+          }
+        }
+      } break;
+      case 6: {
+        if (str) {
+          str_replace(str, 'a', 'b');
+          for (char &c : ref) {
+            c = c == 'a' ? 'b' : c;
+          }
+        }
+      } break;
+      case 7: {
+        char *dup = str_dup(str);
+        CHECK(str_cmp(dup, str) == 0);
+        delete_str(dup);
+      } break;
+      case 8: {
+        str_set(&str, (const char *)nullptr);
+        ref.clear();
+      } break;
+      case 9: {
+        str_cat(&str, (const char *)nullptr);
+      } break;
+      case 10: {
+        std::string other(ref.size(), 'q');
+        CHECK((str_cmp_c(str, other.c_str()) == 0) == (ref == other));
+      } break;
+      }
+      check_str(str, ref);
+    }
+    delete_str(str);
+  }
+}
+
+void test_array_ops() {
+  std::mt19937 rng(4);
+  for (int iter = 0; iter < 3000; ++iter) {
+    int *array = nullptr;
+    std::vector<int> ref;
+    for (int op = 0; op < 100; ++op) {
+      switch (rng() % 8) {
+      case 0: {
+        array_push(&array, op);
+        ref.push_back(op);
+      } break;
+      case 1: {
+        if (!ref.empty()) {
+          CHECK(array_pop(array) == ref.back());
+          ref.pop_back();
+        }
+      } break;
+      case 2: {
+        uint32 n = rng() % (ref.size() + 1);
+        std::vector<int> popped(n + 1);
+        if (array) {
+          array_pop(array, n, popped.data());
+          CHECK(std::equal(popped.begin(), popped.begin() + n, ref.end() - n));
+          ref.resize(ref.size() - n);
+        }
+      } break;
+      case 3: {
+        if (!ref.empty()) {
+          uint32 i = rng() % ref.size();
+          CHECK(array_swap_with_end_then_pop(array, i) == ref[i]);
+          ref[i] = ref.back();
+          ref.pop_back();
+        }
+      } break;
+      case 4: {
+        array_clear(array);
+        ref.clear();
+      } break;
+      case 5: { // pushing its own items, the source moves with the realloc
+        uint32 n = rng() % (ref.size() + 1);
+        array_push(&array, array, n);
+        std::vector<int> copy(ref.begin(), ref.begin() + n);
+        ref.insert(ref.end(), copy.begin(), copy.end());
+      } break;
+      case 6: {
+        if (!ref.empty()) {
+          uint32 i = rng() % ref.size();
+          array_push(&array, array[i]);
+          ref.push_back(ref[i]);
+        }
+      } break;
+      case 7: {
+        uint32 n = rng() % 300;
+        array_resize(&array, n);
+        ref.resize(n);
+      } break;
+      }
+      check_array(array, ref);
+    }
+    delete_array(array);
+  }
+}
+
+void test_array_push_own_item() { // the single item push must copy its item before the grow frees it
+  for (uint32 size = 1; size < 100; ++size) {
+    int *array = nullptr;
+    for (uint32 i = 0; i < size; ++i) {
+      array_push(&array, (int)i + 1000);
+    }
+    array_shrink_to_fit(&array); // full, the next push reallocs
+    array_push(&array, array[size - 1]);
+    CHECK(array_size(array) == size + 1 && array[size] == (int)size - 1 + 1000);
+    delete_array(array);
+  }
+}
+
+void test_container_growth() {
+  CHECK(container_grow_capacity(0, 1, 64) == 64);
+  CHECK(container_grow_capacity(64, 65, 64) == (uint32)(64 * CONTAINER_GROWTH_FACTOR));
+  CHECK(container_grow_capacity(64, 1000, 64) == 1000); // a big push gets what it asked for
+  CHECK(container_grow_capacity(UINT32_MAX / 2 + 1, UINT32_MAX, 64) == UINT32_MAX);
+  for (uint32 n : {1u, 63u, 64u, 65u, 200u, 5000u}) { // bulk pushes onto a null array, free used to underflow past 64
+    std::vector<int> items(n, 7);
+    int *array = nullptr;
+    array_push(&array, items.data(), n);
+    CHECK(array_size(array) == n && array_capacity(array) == max(n, ARRAY_INIT_CAPACITY));
+    array_push(&array, 8);
+    CHECK(array_size(array) == n + 1 && array[n] == 8);
+    delete_array(array);
+  }
+  int *array = nullptr;
+  array_reserve(&array, 100);
+  CHECK(array_capacity(array) == 100 && array_size(array) == 0);
+  array_resize(&array, 30);
+  array_shrink_to_fit(&array);
+  CHECK(array_capacity(array) == 30 && array_size(array) == 30);
+  array_push(&array, 1);
+  CHECK(array_capacity(array) == max((uint32)(30 * CONTAINER_GROWTH_FACTOR), ARRAY_INIT_CAPACITY));
+  delete_array(array);
+
+  char *str = nullptr;
+  str_cat(&str, 'x');
+  CHECK(str_capacity(str) == STRING_INIT_CAPACITY);
+  CHECK(sizeof(StringHeader) + STRING_INIT_CAPACITY + 1 == 64);
+  str_reserve(&str, 1000);
+  CHECK(str_capacity(str) == 1000 && str_len(str) == 1);
+  str_shrink_to_fit(&str);
+  CHECK(str_capacity(str) == 1);
+  delete_str(str);
+
+  #ifdef CONTAINER_STATS
+  int *pushed = nullptr;
+  for (uint32 i = 0; i < 100000; ++i) {
+    array_push(&pushed, (int)i);
+  }
+  ContainerStats stats = array_stats(pushed);
+  CHECK(stats.num_reallocs > 0 && stats.num_reallocs < 20); // geometric growth
+  CHECK(stats.bytes_moved < 2 * 100000 * sizeof(int) * CONTAINER_GROWTH_FACTOR);
+  delete_array(pushed);
+  #endif
+}
+
+void bench_containers() {
+  const uint32 n = 10000000;
+  int *array = nullptr;
+  char *str = nullptr;
+  printf("array_push     %6.2f ns/op\n", bench_ns_per_op(n, [&] {
+    for (uint32 i = 0; i < n; ++i) {
+      array_push(&array, (int)i);
+    }
+  }));
+  printf("array_pop      %6.2f ns/op\n", bench_ns_per_op(n, [&] {
+    for (uint32 i = 0; i < n; ++i) {
+      bench_sink += array_pop(array);
+    }
+  }));
+  printf("array_resize   %6.2f ns/op\n", bench_ns_per_op(n / 100, [&] {
+    for (uint32 i = 0; i < n / 100; ++i) {
+      array_resize(&array, i * 7919 % 4096);
+    }
+  }));
+  printf("str_cat char   %6.2f ns/op\n", bench_ns_per_op(n, [&] {
+    for (uint32 i = 0; i < n; ++i) {
+      str_cat(&str, 'x');
+    }
+  }));
+  str_set_c(&str, "");
+  printf("str_cat_c 16   %6.2f ns/op\n", bench_ns_per_op(n / 10, [&] {
+    for (uint32 i = 0; i < n / 10; ++i) {
+      str_cat_c(&str, "0123456789abcdef");
+    }
+  }));
+  printf("str_pop        %6.2f ns/op\n", bench_ns_per_op(n, [&] {
+    for (uint32 i = 0; i < n; ++i) {
+      str_pop(str, 1);
+    }
+  }));
+  delete_array(array);
+  delete_str(str);
+}
+
+void test_hash_map() {
+  std::mt19937 rng(2);
+  for (int iter = 0; iter < 200; ++iter) {
+    HashMap<int, int> map = {};
+    std::unordered_map<int, int> ref;
+    int key_range = 1 + rng() % 5000; // small ranges churn tombstones, big ones grow
+    for (int op = 0; op < 5000; ++op) {
+      int key = rng() % key_range;
+      switch (rng() % 3) {
+      case 0: {
+        hash_map_insert(&map, key, op);
+        ref[key] = op;
+      } break;
+      case 1: {
+        int value = -1;
+        bool removed = hash_map_remove(&map, key, &value);
+        auto it = ref.find(key);
+        CHECK(removed == (it != ref.end()));
+        if (removed) {
+          CHECK(value == it->second);
+          ref.erase(it);
+        }
+      } break;
+      case 2: {
+        int *value = hash_map_find(&map, key);
+        auto it = ref.find(key);
+        CHECK((value != nullptr) == (it != ref.end()));
+        CHECK(!value || *value == it->second);
+      } break;
+      }
+      CHECK(map.size == ref.size());
+    }
+    uint32 num_visited = 0;
+    hash_map_for_each(&map, [&](int key, int *value) {
+      CHECK(ref.at(key) == *value);
+      num_visited += 1;
+    });
+    CHECK(num_visited == ref.size());
+    if (iter % 2) {
+      hash_map_clear(&map);
+      CHECK(map.size == 0 && !hash_map_find(&map, 0));
+    }
+    delete_hash_map(&map);
+  }
+  HashMap<const char *, int> names = {}; // compared by content, not by pointer
+  hash_map_insert(&names, (const char *)"www.google.com", 1);
+  char name[32];
+  strcpy(name, "www.google.com");
+  CHECK(hash_map_find(&names, (const char *)name) && *hash_map_find(&names, (const char *)name) == 1);
+  CHECK(hash_map_remove(&names, (const char *)name) && names.size == 0);
+  delete_hash_map(&names);
+}
+
+// fd to connection lookups, a linear scan of an array against the hash map, at 10, 100 and 10k entries
+void bench_hash_map() {
+  struct Connection {
+    int socket_fd;
+    const char *domain_name;
+  };
+  std::mt19937 rng(2);
+  for (uint32 n : {10u, 100u, 10000u}) {
+    Connection *array = nullptr;
+    HashMap<int, Connection> map = {};
+    for (uint32 i = 0; i < n; ++i) {
+      Connection conn = {(int)i * 7 + 3, "www.example.com"};
+      array_push(&array, conn);
+      hash_map_insert(&map, conn.socket_fd, conn);
+    }
+    uint32 num_lookups = n < 1000 ? 2000000 : 200000;
+    std::vector<int> fds(num_lookups);
+    for (int &fd : fds) {
+      fd = (int)(rng() % n) * 7 + 3;
+    }
+    double linear = bench_ns_per_op(num_lookups, [&] {
+      for (int fd : fds) {
+        for (uint32 i = 0; i < array_size(array); ++i) {
+          if (array[i].socket_fd == fd) {
+            bench_sink += i;
+            break;
+          }
+        }
+      }
+    });
+    double hashed = bench_ns_per_op(num_lookups, [&] {
+      for (int fd : fds) {
+        bench_sink += hash_map_find(&map, fd)->socket_fd;
+      }
+    });
+    printf("n=%5u  linear %7.1f ns/lookup  hash map %5.1f ns/lookup\n", n, linear, hashed);
+    delete_array(array);
+    delete_hash_map(&map);
+  }
+}
+
+void test_arena() {
+  Arena arena;
+  CHECK(init_arena(&arena, 1024));
+  CHECK((uintptr_t)arena.buf % ARENA_ALIGNMENT == 0);
+  {
+    ARENA_SCOPE(&arena);
+    for (size_t size : {1, 15, 16, 17, 100}) {
+      byte *ptr = ARENA_ALLOC(&arena, byte, size);
+      CHECK(ptr && (uintptr_t)ptr % ARENA_ALIGNMENT == 0 && arena_owns(&arena, ptr) && arena_owns(&arena, ptr + size - 1));
+      memset(ptr, 0xab, size);
+    }
+    uint32 used = arena.used;
+    {
+      ARENA_SCOPE(&arena);
+      CHECK(ARENA_ALLOC(&arena, uint64, 8));
+      {
+        ARENA_SCOPE(&arena);
+        CHECK(ARENA_ALLOC(&arena, byte, arena.capacity - arena.used)); // fills it exactly
+        CHECK(arena.used == arena.capacity);
+        CHECK(!arena_alloc(&arena, 1));
+      }
+      CHECK(arena.used == used + 64);
+    }
+    CHECK(arena.used == used);
+    CHECK(!arena_alloc(&arena, arena.capacity));
+    CHECK(!arena_alloc(&arena, SIZE_MAX));
+    CHECK(!arena_alloc(&arena, SIZE_MAX - ARENA_ALIGNMENT + 2));
+    CHECK(arena.used == used);
+  }
+  CHECK(arena.used == 0);
+  int on_stack = 0;
+  int *on_heap = MALLOC(int, 1);
+  CHECK(!arena_owns(&arena, &on_stack) && !arena_owns(&arena, on_heap) && !arena_owns(&arena, arena.buf + arena.capacity));
+  FREE(on_heap);
+  delete_arena(&arena);
+}
+
+// reallocs and bytes moved for pushes one at a time, from CONTAINER_STATS builds. try -DCONTAINER_GROWTH_FACTOR=1.5
+void bench_container_growth() {
+  #ifdef CONTAINER_STATS
+  printf("growth factor %.2f\n", (double)CONTAINER_GROWTH_FACTOR);
+  for (uint32 n : {100u, 10000u, 1000000u}) {
+    int *array = nullptr;
+    char *str = nullptr;
+    double ns = bench_ns_per_op(n, [&] {
+      for (uint32 i = 0; i < n; ++i) {
+        array_push(&array, (int)i);
+        str_cat(&str, 'x');
+      }
+    });
+    printf("n=%7u  array reallocs %2u moved %9llu bytes  str reallocs %2u moved %9llu bytes  %.2f ns/push pair\n", n,
+           array_stats(array).num_reallocs, (unsigned long long)array_stats(array).bytes_moved,
+           str_stats(str).num_reallocs, (unsigned long long)str_stats(str).bytes_moved, ns);
+    delete_array(array);
+    delete_str(str);
+  }
+  #else
+  printf("build with -DCONTAINER_STATS for the realloc counts\n");
+  #endif
+}
+
+void test_font_atlas_height() {
+  CHECK(fit_font_atlas_height(0, 1024) == FONT_ATLAS_MIN_HEIGHT);
+  CHECK(fit_font_atlas_height(1, 1024) == FONT_ATLAS_MIN_HEIGHT);
+  CHECK(fit_font_atlas_height(FONT_ATLAS_MIN_HEIGHT, 1024) == FONT_ATLAS_MIN_HEIGHT);
+  CHECK(fit_font_atlas_height(FONT_ATLAS_MIN_HEIGHT + 1, 1024) == FONT_ATLAS_MIN_HEIGHT * 2);
+  CHECK(fit_font_atlas_height(298, 1024) == 512);
+  CHECK(fit_font_atlas_height(512, 1024) == 512);
+  CHECK(fit_font_atlas_height(513, 1024) == 1024);
+  CHECK(fit_font_atlas_height(1024, 1024) == 1024);
+  CHECK(fit_font_atlas_height(1025, 1024) == 1024); // content taller than the max is clamped, not rounded past it
+  CHECK(fit_font_atlas_height(5000, 1024) == 1024);
+  CHECK(fit_font_atlas_height(600, 1000) == 1000); // a max that is no power of two is still the cap
+  CHECK(fit_font_atlas_height(10, 32) == 32); // a max under the minimum wins over the minimum
+  for (int content_h = 0; content_h < 3000; ++content_h) {
+    for (int max_h : {FONT_ATLAS_MIN_HEIGHT, 1000, 1024, 2048}) {
+      int h = fit_font_atlas_height(content_h, max_h);
+      CHECK(h <= max_h && (h >= content_h || h == max_h));
+      CHECK(h == max_h || (h & (h - 1)) == 0);
+      CHECK(h == FONT_ATLAS_MIN_HEIGHT || h == max_h || h / 2 < content_h); // no bigger than needed
+    }
+  }
+
+  // trimmed to the baked glyphs at first, then doubling as glyphs come in, with packed glyphs staying put
+  for (bool with_baked : {false, true}) {
+    Program::Fonts fonts;
+    CHECK(init_fonts(&fonts));
+    FileMap ttf;
+    CHECK(map_file(&ttf, "assets/fonts/open-sans/OpenSans-Regular.ttf"));
+    uint32 font = add_font(&fonts, add_font_face(&fonts, &ttf), 64);
+    int baked_h = 0;
+    if (with_baked) {
+      FileMap baked_atlas;
+      CHECK(map_file(&baked_atlas, "assets/fonts/open-sans/OpenSans-Regular.atlas"));
+      Program::Fonts::Face *face = &fonts.faces[fonts.fonts[font].face];
+      CHECK(!check_baked_font_atlas(baked_atlas.data, baked_atlas.len, face->font_file.data, face->font_file.len, 64, FONT_ATLAS_SIZE, FONT_ATLAS_SIZE));
+      baked_h = (int)((const BakedFontAtlasHeader *)baked_atlas.data)->baked_h;
+      install_baked_font_atlas(&fonts, font, &baked_atlas);
+    }
+    init_font_atlas_texture(&fonts);
+    fonts.atlas_gl_texture_id = 1;
+    CHECK(fonts.atlas_h == fit_font_atlas_height(baked_h, fonts.atlas_max_h));
+    Program::Fonts::Glyph first;
+    CHECK(get_font_glyph(&fonts, font, 0x410, &first));
+    int num_grows = 0;
+    for (uint32 codepoint = 0x411; codepoint < 0x700; ++codepoint) {
+      int old_h = fonts.atlas_h;
+      Program::Fonts::Glyph glyph;
+      CHECK(get_font_glyph(&fonts, font, codepoint, &glyph));
+      CHECK(glyph.packed_char.y1 <= fonts.atlas_h);
+      if (fonts.atlas_h != old_h) {
+        CHECK(fonts.atlas_h == min(old_h * 2, fonts.atlas_max_h));
+        num_grows += 1;
+        Program::Fonts::Glyph *moved = hash_map_find(&fonts.glyphs, font_glyph_id(&fonts, font, 0x410));
+        CHECK(moved && moved->packed_char.x0 == first.packed_char.x0 && moved->packed_char.y0 == first.packed_char.y0);
+      }
+    }
+    CHECK(num_grows > 0);
+    delete_fonts(&fonts);
+  }
+}
+
+void test_text_layout() {
+  Program *program = new_text_program(32);
+  Program::Fonts *fonts = &program->fonts;
+  uint32 font = program->on_screen_text.layout.font;
+  TextLayout layout = {};
+  layout.font = font;
+  layout.max_width = 300;
+  const char *text = "The quick brown fox jumps over the lazy dog.\nAVAVAV To Ty\n\nsupercalifragilisticexpialidocious-and-then-some tail   ";
+  CHECK(layout_text(fonts, &layout, text, strlen(text)));
+  check_wrapped_layout(&layout, text);
+  CHECK(array_size(layout.lines) > 4);
+  Program::Fonts::Face *face = &fonts->faces[fonts->fonts[font].face];
+  int a = get_font_glyph_metrics(face, 'A').glyph_index;
+  int v = get_font_glyph_metrics(face, 'V').glyph_index;
+  CHECK(get_font_kern_advance(face, a, v) < 0);
+  CHECK(layout_text(fonts, &layout, "", 0));
+  CHECK(array_size(layout.lines) == 1 && array_size(layout.instances) % TEXT_LAYOUT_LINE_SPARE_SLOTS == 0);
+  CHECK(layout_text(fonts, &layout, "a\n", 2));
+  CHECK(array_size(layout.lines) == 2 && layout.lines[1].begin == 2);
+  layout.max_width = 0;
+  CHECK(layout_text(fonts, &layout, text, strlen(text)));
+  CHECK(array_size(layout.lines) == 4); // newlines only
+  delete_text_layout(&layout);
+
+  // appending word by word ends where laying the whole text out does
+  program->opengl_es.surface_width = 500;
+  reset_on_screen_text_layout(program);
+  const char *words[] = {"hello ", "world ", "this\n", "is a ", "longer ", "sentence ", "that should wrap ", "somewhere ", "x"};
+  for (int i = 0; i < 30; ++i) {
+    for (const char *word : words) {
+      add_chars_to_on_screen_text(program, word);
+    }
+  }
+  TextLayout fresh = {};
+  fresh.font = font;
+  fresh.y = 250;
+  fresh.max_width = 500;
+  fresh.rgba = program->on_screen_text.layout.rgba;
+  CHECK(layout_text(fonts, &fresh, program->on_screen_text.text, str_len(program->on_screen_text.text)));
+  check_layout_prefix(&program->on_screen_text.layout, &fresh);
+  check_layout_prefix(&fresh, &program->on_screen_text.layout);
+  check_wrapped_layout(&fresh, program->on_screen_text.text);
+  delete_text_layout(&fresh);
+  delete_text_program(program);
+}
+
+// random edits laid out incrementally match a fresh layout, and the dirty range covers every changed instance
+void test_text_relayout() {
+  Program *program = new_text_program(24);
+  Program::Fonts *fonts = &program->fonts;
+  std::mt19937 rng(7);
+  const char *pieces[] = {"a", "b", " ", "  ", "\n", "word ", "longwordwithoutanyspacesatallreallylongwordwithoutanyspacesatall", "x y z", "\xd0\x96", "AV", "",
+                          "f", "fi", "office ", "\xcc\x81", "e\xcc\x81\xcc\x81"};
+  char *text = nullptr;
+  str_set_c(&text, "");
+  TextLayout layout = {};
+  layout.font = program->on_screen_text.layout.font;
+  layout.max_width = 200;
+  layout.y = 10;
+  std::vector<GlyphInstance> uploaded;
+  for (int iter = 0; iter < 5000; ++iter) {
+    uint32 len = str_len(text);
+    uint32 begin = len ? rng() % (len + 1) : 0;
+    uint32 end = rng() % 3 ? begin + (len - begin ? rng() % min(len - begin + 1, 12u) : 0) : begin;
+    while (begin > 0 && ((uchar)text[begin] & 0xc0) == 0x80) {
+      begin -= 1;
+    }
+    while (end < len && ((uchar)text[end] & 0xc0) == 0x80) {
+      end += 1;
+    }
+    const char *piece = pieces[rng() % ARRAY_LEN(pieces)];
+    if (len > 3000) { // delete only, to keep it in check
+      piece = "";
+      end = min(len, begin + 40);
+      while (end < len && ((uchar)text[end] & 0xc0) == 0x80) {
+        end += 1;
+      }
+    }
+    str_splice(&text, begin, end, piece, strlen(piece));
+    uint32 dirty_begin, dirty_end;
+    CHECK(relayout_text(fonts, &layout, text, str_len(text), begin, end, begin + strlen(piece), &dirty_begin, &dirty_end));
+    uint32 num_instances = array_size(layout.instances);
+    CHECK(dirty_begin <= dirty_end && dirty_end <= num_instances);
+    CHECK(uploaded.size() >= num_instances || dirty_end == num_instances); // what grew is in the dirty range
+    uploaded.resize(num_instances);
+    std::copy(layout.instances + dirty_begin, layout.instances + dirty_end, uploaded.begin() + dirty_begin);
+    CHECK(!memcmp(uploaded.data(), layout.instances, num_instances * sizeof(GlyphInstance)));
+    TextLayout fresh = {};
+    fresh.font = layout.font;
+    fresh.max_width = layout.max_width;
+    fresh.y = layout.y;
+    CHECK(layout_text(fonts, &fresh, text, str_len(text)));
+    CHECK(array_size(layout.lines) == array_size(fresh.lines));
+    check_layout_prefix(&layout, &fresh);
+    delete_text_layout(&fresh);
+  }
+  delete_text_layout(&layout);
+  delete_str(text);
+  delete_text_program(program);
+}
+
+// a megabyte of text is laid out a page past the surface, more as it scrolls in, and edits keep it a prefix of the
+// full layout
+void test_on_screen_text_scroll() {
+  Program *program = new_text_program(64);
+  const Program::Fonts::Font *font = &program->fonts.fonts[program->on_screen_text.layout.font];
+  TextLayout *layout = &program->on_screen_text.layout;
+  float line_height = font->line_height;
+  char *doc = nullptr;
+  while (str_len(doc) < 1000000) {
+    str_cat_c(&doc, "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore et dolore magna aliqua.\n");
+  }
+  add_chars_to_on_screen_text(program, doc);
+  delete_str(doc);
+  CHECK(layout->truncated && array_size(layout->lines) == get_on_screen_text_line_limit(program));
+  for (uint32 i = 0; i < array_size(layout->lines); ++i) {
+    for (uint32 j = 0; j < layout->lines[i].num_instances; ++j) {
+      CHECK(layout->instances[layout->lines[i].first_instance + j].y == text_vertex_coord(font->ascent + i % font->page_lines * line_height));
+    }
+  }
+  uint32 first, end;
+  get_visible_text_lines(&program->fonts, layout, 0, 1920, &first, &end);
+  CHECK(first == 0 && end == (uint32)ceilf((1920 - 250) / line_height));
+  for (int i = 0; i < 200; ++i) {
+    scroll_on_screen_text(program, 1500);
+  }
+  float scroll_y = program->on_screen_text.scroll_y;
+  get_visible_text_lines(&program->fonts, layout, scroll_y, scroll_y + 1920, &first, &end);
+  CHECK(end <= array_size(layout->lines) && end - first <= 1920 / line_height + 2);
+  CHECK(array_size(layout->lines) >= end);
+
+  TextLayout full = {};
+  full.font = layout->font;
+  full.y = layout->y;
+  full.max_width = layout->max_width;
+  full.rgba = layout->rgba;
+  std::mt19937 rng(3);
+  for (int i = 0; i < 300; ++i) {
+    uint32 len = str_len(program->on_screen_text.text);
+    uint32 at = rng() % 300000;
+    if (rng() % 2) {
+      replace_on_screen_text(program, at, at, rng() % 4 ? "xy " : "\n");
+    } else {
+      replace_on_screen_text(program, at, min(len, at + 5), "");
+    }
+  }
+  CHECK(layout_text(&program->fonts, &full, program->on_screen_text.text, str_len(program->on_screen_text.text)));
+  check_layout_prefix(layout, &full);
+  CHECK(layout->truncated == (array_size(layout->lines) < array_size(full.lines)));
+  for (int i = 0; i < 2000; ++i) {
+    scroll_on_screen_text(program, 5000);
+  }
+  check_layout_prefix(layout, &full);
+  CHECK(!layout->truncated && array_size(layout->lines) == array_size(full.lines));
+  CHECK(fabsf(program->on_screen_text.scroll_y - (layout->y + array_size(layout->lines) * line_height - 1920)) < 1);
+  delete_text_layout(&full);
+  delete_text_program(program);
+
+  // fonts too tall for 64 lines a page get fewer, with page relative y still in int16
+  for (float size : {64.0f, 200.0f, 600.0f}) {
+    program = new_text_program(size);
+    font = &program->fonts.fonts[program->on_screen_text.layout.font];
+    CHECK(font->page_lines >= 1 && font->page_lines <= TEXT_LAYOUT_PAGE_LINES);
+    CHECK((font->ascent + font->line_height * font->page_lines) * TEXT_VERTEX_SUBPIXELS <= 32767.0f);
+    CHECK(size > 64.0f ? font->page_lines < TEXT_LAYOUT_PAGE_LINES : font->page_lines == TEXT_LAYOUT_PAGE_LINES);
+    delete_text_program(program);
+  }
+}
+
+// marks share their base's cluster, advance nothing, and stack away from it. one with no box to go by sits at the
+// base's pen position and leaves the stack as it was
+void test_shape_combining_marks() {
+  Program *program = new_text_program(64);
+  Program::Fonts *fonts = &program->fonts;
+  uint32 font = program->on_screen_text.layout.font;
+  auto shape = [&](const char *text) {
+    const Program::Fonts::ShapedRun *run = shape_text_run(fonts, font, text, strlen(text));
+    return std::vector<Program::Fonts::ShapedGlyph>(run->glyphs, run->glyphs + array_size(run->glyphs));
+  };
+  float a_width = shape_text_run(fonts, font, "a", 1)->width;
+  std::vector<Program::Fonts::ShapedGlyph> a_joiner = shape("a\xcd\x8f"); // U+034F
+  CHECK(a_joiner.size() == 2 && a_joiner[1].codepoint == 0x34f);
+  CHECK(a_joiner[1].cluster == 0 && a_joiner[1].advance == 0);
+  CHECK(a_joiner[1].x == a_joiner[0].x && a_joiner[1].y == 0);
+  CHECK(shape_text_run(fonts, font, "a\xcd\x8f", 3)->width == a_width);
+  std::vector<Program::Fonts::ShapedGlyph> a_acute = shape("a\xcc\x81");
+  std::vector<Program::Fonts::ShapedGlyph> a_joiner_acute = shape("a\xcd\x8f\xcc\x81");
+  CHECK(a_joiner_acute[2].x == a_acute[1].x && a_joiner_acute[2].y == a_acute[1].y);
+
+  std::vector<Program::Fonts::ShapedGlyph> e_acutes = shape("e\xcc\x81\xcc\x81"); // U+0301 twice
+  CHECK(e_acutes.size() == 3);
+  for (uint32 i = 1; i < 3; ++i) {
+    CHECK(e_acutes[i].cluster == 0 && e_acutes[i].advance == 0);
+  }
+  CHECK(e_acutes[1].x == e_acutes[2].x); // both centered over the e
+  CHECK(e_acutes[1].x > e_acutes[0].x && e_acutes[1].x < e_acutes[0].x + e_acutes[0].advance);
+  CHECK(e_acutes[1].y <= 0 && e_acutes[2].y < e_acutes[1].y); // y down, the second one goes over the first
+  CHECK(shape_text_run(fonts, font, "e\xcc\x81\xcc\x81", 5)->width == shape_text_run(fonts, font, "e", 1)->width);
+  delete_text_program(program);
+}
+
+// gsub ligatures, kerning, and the shaped run cache staying within its cap
+void test_shape_text_run() {
+  Program *program = new_text_program(64);
+  Program::Fonts *fonts = &program->fonts;
+  uint32 font = program->on_screen_text.layout.font;
+  const Program::Fonts::Font *f = &fonts->fonts[font];
+  Program::Fonts::Face *face = &fonts->faces[f->face];
+  for (const char *text : {"fi", "ffi"}) {
+    const Program::Fonts::ShapedRun *run = shape_text_run(fonts, font, text, strlen(text));
+    CHECK(array_size(run->glyphs) == 1);
+    const Program::Fonts::ShapedGlyph *ligature = &run->glyphs[0];
+    CHECK(ligature->cluster == 0 && ligature->x == 0);
+    CHECK(ligature->codepoint == FONT_GLYPH_INDEX_CODEPOINTS + (uint32)ligature->glyph_index);
+    int advance;
+    stbtt_GetGlyphHMetrics(&face->info, ligature->glyph_index, &advance, nullptr);
+    CHECK(ligature->advance == advance * f->scale_factor && run->width == ligature->advance);
+  }
+  const Program::Fonts::ShapedRun *office = shape_text_run(fonts, font, "office", 6);
+  CHECK(array_size(office->glyphs) == 4 && office->glyphs[1].cluster == 1 && office->glyphs[2].cluster == 4);
+
+  const Program::Fonts::ShapedRun *marked = shape_text_run(fonts, font, "xe\xcc\x81y", 5);
+  CHECK(array_size(marked->glyphs) == 4 && marked->glyphs[2].cluster == 1 && marked->glyphs[2].advance == 0);
+  CHECK(marked->glyphs[3].x == marked->glyphs[1].x + marked->glyphs[1].advance + get_font_kern_advance(face, marked->glyphs[1].glyph_index, marked->glyphs[3].glyph_index) * f->scale_factor);
+
+  float a_width = shape_text_run(fonts, font, "A", 1)->width;
+  float v_width = shape_text_run(fonts, font, "V", 1)->width;
+  const Program::Fonts::ShapedRun *av = shape_text_run(fonts, font, "AV", 2);
+  CHECK(av->width < a_width + v_width && av->glyphs[1].x < a_width);
+
+  char text[16];
+  for (uint32 i = 0; i <= FONT_SHAPED_RUN_CACHE_SIZE; ++i) {
+    snprintf(text, sizeof(text), "w%u", i);
+    shape_text_run(fonts, font, text, strlen(text));
+    shape_text_run(fonts, font, "recent", 6);
+    CHECK(fonts->shaped_runs.size <= FONT_SHAPED_RUN_CACHE_SIZE);
+  }
+  Program::Fonts::ShapedRun *recent = hash_map_find(&fonts->shaped_runs, hash_text_run(font, "recent", 6));
+  CHECK(recent && array_size(recent->text) == 6 && !memcmp(recent->text, "recent", 6));
+  CHECK(!hash_map_find(&fonts->shaped_runs, hash_text_run(font, "w0", 2)));
+  delete_text_program(program);
+}
+
+// the cpu copy of the glyphs vertex shader puts each glyph where stb_truetype's packed quad for it goes, scaled from
+// the raster size and moved to the instance's pen position
+void test_expand_glyph_instances() {
+  for (float size : {24.0f, 64.0f}) {
+    Program *program = new_text_program(size);
+    Program::Fonts *fonts = &program->fonts;
+    TextLayout layout = {};
+    layout.font = program->on_screen_text.layout.font;
+    layout.x = 12.5f;
+    layout.y = 40;
+    layout.max_width = 400;
+    layout.rgba = 0x11223344;
+    const char *text = "The office files\nAVAVA e\xcc\x81 \xd0\x96\xd0\xb8\xd0\xb7\xd0\xbd\xd1\x8c wrapping goes on past the width";
+    CHECK(layout_text(fonts, &layout, text, strlen(text)));
+    std::vector<const stbtt_packedchar *> slot_packed_chars(FONT_GLYPH_TABLE_SLOTS);
+    hash_map_for_each(&fonts->glyphs, [&](uint32, Program::Fonts::Glyph *glyph) {
+      slot_packed_chars[glyph->slot] = &glyph->packed_char;
+    });
+    uint32 num_instances = array_size(layout.instances);
+    std::vector<TextVertex> verts(num_instances * 4);
+    expand_glyph_instances(fonts, layout.instances, num_instances, verts.data());
+    uint32 num_glyphs = 0;
+    for (uint32 i = 0; i < num_instances; ++i) {
+      const GlyphInstance *instance = &layout.instances[i];
+      if (instance->scale == 0) { // a spare slot
+        continue;
+      }
+      num_glyphs += 1;
+      CHECK(slot_packed_chars[instance->slot]);
+      stbtt_aligned_quad quad;
+      float pen_x = 0, pen_y = 0;
+      stbtt_GetPackedQuad((stbtt_packedchar *)slot_packed_chars[instance->slot], fonts->atlas_w, fonts->atlas_h, 0, &pen_x, &pen_y, &quad, 0);
+      float scale = (float)instance->scale / GLYPH_INSTANCE_SCALE_ONE;
+      float x = (float)instance->x / TEXT_VERTEX_SUBPIXELS;
+      float y = (float)instance->y / TEXT_VERTEX_SUBPIXELS;
+      TextVertex expected[4];
+      put_text_quad(expected, x + quad.x0 * scale, y + quad.y0 * scale, x + quad.x1 * scale, y + quad.y1 * scale,
+                    quad.s0, quad.t0, quad.s1, quad.t1, layout.rgba);
+      CHECK(!memcmp(expected, &verts[i * 4], sizeof(expected)));
+      CHECK(verts[i * 4].x < verts[i * 4 + 1].x && verts[i * 4].y < verts[i * 4 + 2].y);
+    }
+    CHECK(num_glyphs > 40);
+    delete_text_layout(&layout);
+    delete_text_program(program);
+  }
+}
+
+// a megabyte laid out from scratch, single char edits in its middle, and the visible range lookup done every frame
+void bench_text_layout() {
+  Program *program = new_text_program(32);
+  char *doc = nullptr;
+  while (str_len(doc) < 1000000) {
+    str_cat_c(&doc, "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut aliquip ex ea commodo consequat.\n");
+  }
+  TextLayout layout = {};
+  layout.font = program->on_screen_text.layout.font;
+  layout.max_width = 1080;
+  for (int i = 0; i < 3; ++i) { // the first pass rasterizes the glyphs
+    double ns = bench_ns_per_op(1, [&] { CHECK(layout_text(&program->fonts, &layout, doc, str_len(doc))); });
+    printf("1MB layout: %u lines %u instances %.1f ms\n", array_size(layout.lines), array_size(layout.instances), ns / 1e6);
+  }
+  uint64 num_dirty = 0;
+  double ns = bench_ns_per_op(1000, [&] {
+    for (uint32 i = 0; i < 1000; ++i) {
+      uint32 at = 500000 + i;
+      str_splice(&doc, at, at, "q", 1);
+      uint32 dirty_begin, dirty_end;
+      CHECK(relayout_text(&program->fonts, &layout, doc, str_len(doc), at, at, at + 1, &dirty_begin, &dirty_end));
+      num_dirty += dirty_end - dirty_begin;
+    }
+  });
+  printf("single char insert mid document: %.1f us, %.0f instances dirty\n", ns / 1e3, num_dirty / 1000.0);
+  uint32 first, end;
+  ns = bench_ns_per_op(1000000, [&] {
+    for (uint32 i = 0; i < 1000000; ++i) {
+      get_visible_text_lines(&program->fonts, &layout, (float)(i % 100000), (float)(i % 100000) + 1920, &first, &end);
+      bench_sink += end - first;
+    }
+  });
+  printf("visible lines lookup: %.1f ns\n", ns);
+  delete_text_layout(&layout);
+  delete_str(doc);
+  delete_text_program(program);
+}
+
+void test_utf8_decode() {
+  struct Case {
+    const char *bytes;
+    std::vector<uint32> codepoints;
+  };
+  const uint32 bad = 0xfffd;
+  const Case cases[] = {
+    {"\xc2\x80", {0x80}},
+    {"\xdf\xbf", {0x7ff}},
+    {"\xe0\xa0\x80", {0x800}},
+    {"\xed\x9f\xbf", {0xd7ff}},
+    {"\xee\x80\x80", {0xe000}},
+    {"\xef\xbf\xbf", {0xffff}},
+    {"\xf0\x90\x80\x80", {0x10000}},
+    {"\xf4\x8f\xbf\xbf", {0x10ffff}},
+    // overlong
+    {"\xc0\xaf", {bad, bad}},
+    {"\xc1\xbf", {bad, bad}},
+    {"\xe0\x80\xaf", {bad, bad, bad}},
+    {"\xe0\x9f\xbf", {bad, bad, bad}},
+    {"\xf0\x80\x80\xaf", {bad, bad, bad, bad}},
+    {"\xf0\x8f\xbf\xbf", {bad, bad, bad, bad}},
+    // surrogates
+    {"\xed\xa0\x80", {bad, bad, bad}},
+    {"\xed\xbf\xbf", {bad, bad, bad}},
+    // past U+10FFFF
+    {"\xf4\x90\x80\x80", {bad, bad, bad, bad}},
+    {"\xf5\x80\x80\x80", {bad, bad, bad, bad}},
+    {"\xff", {bad}},
+    // truncated, the maximal subpart is one U+FFFD
+    {"\xe2\x82", {bad}},
+    {"\xe2\x82x", {bad, 'x'}},
+    {"\xf0\x9f\x98", {bad}},
+    {"\xf0\x9f\x98 \xf0\x9f\x98\x80", {bad, ' ', 0x1f600}},
+    {"\xc2", {bad}},
+    // stray continuation bytes
+    {"\x80", {bad}},
+    {"\x80\xbf", {bad, bad}},
+    // unicode 3.9, table 3-8
+    {"\x61\xf1\x80\x80\xe1\x80\xc2\x62\x80\x63\x80\xbf\x64", {'a', bad, bad, bad, 'b', bad, 'c', bad, bad, 'd'}},
+  };
+  for (const Case &c : cases) {
+    for (uint32 ascii_prefix = 0; ascii_prefix < 34; ++ascii_prefix) { // in and across the 16 byte simd blocks
+      std::string bytes = std::string(ascii_prefix, 'a') + c.bytes;
+      std::vector<uint32> expected(ascii_prefix, 'a');
+      expected.insert(expected.end(), c.codepoints.begin(), c.codepoints.end());
+      CHECK(utf8_decode_both(bytes) == expected);
+      CHECK(utf8_decode_both(bytes + std::string(ascii_prefix, 'b')).size() == expected.size() + ascii_prefix);
+    }
+  }
+
+  std::mt19937 rng(1);
+  for (int iter = 0; iter < 20000; ++iter) {
+    std::vector<uint32> codepoints;
+    std::string bytes;
+    uint32 num_codepoints = rng() % 40;
+    for (uint32 i = 0; i < num_codepoints; ++i) {
+      uint32 ranges[][2] = {{0, 0x80}, {0, 0x80}, {0x80, 0x800}, {0x800, 0xd800}, {0xe000, 0x10000}, {0x10000, 0x110000}};
+      uint32 *range = ranges[rng() % ARRAY_LEN(ranges)];
+      codepoints.push_back(range[0] + rng() % (range[1] - range[0]));
+      utf8_encode(codepoints.back(), &bytes);
+    }
+    CHECK(utf8_decode_both(bytes) == codepoints);
+    // ill formed input: the scalar and simd paths still agree, and never produce more codepoints than bytes
+    const uchar mutations[] = {0x80, 0xbf, 0xc0, 0xc1, 0xe0, 0xed, 0xf0, 0xf4, 0xf5, 0xff};
+    for (uint32 i = rng() % 4; i > 0 && !bytes.empty(); --i) {
+      bytes[rng() % bytes.size()] = rng() % 2 ? (char)mutations[rng() % ARRAY_LEN(mutations)] : (char)rng();
+    }
+    if (rng() % 2 && !bytes.empty()) {
+      bytes.resize(rng() % bytes.size());
+    }
+    CHECK(utf8_decode_both(bytes).size() <= bytes.size());
+  }
+}
+
+// 4kb of ascii and 4kb of cyrillic, in bulk against a utf8_decode loop
+void bench_utf8_decode() {
+  std::string ascii, cyrillic;
+  for (uint32 i = 0; ascii.size() < 4096; ++i) {
+    utf8_encode('a' + i % 26, &ascii);
+  }
+  for (uint32 i = 0; cyrillic.size() < 4096; ++i) {
+    utf8_encode(i % 8 == 7 ? ' ' : 0x430 + i % 32, &cyrillic);
+  }
+  for (const std::string *text : {&ascii, &cyrillic}) {
+    const char *begin = text->data();
+    const char *end = begin + text->size();
+    uint32 reps = 100000;
+    uint32 *codepoints = nullptr;
+    double bulk = bench_ns_per_op(reps, [&] {
+      for (uint32 r = 0; r < reps; ++r) {
+        array_clear(codepoints);
+        utf8_decode_to_array(begin, end, &codepoints);
+        bench_sink += codepoints[r % array_size(codepoints)];
+      }
+    });
+    double scalar = bench_ns_per_op(reps, [&] {
+      for (uint32 r = 0; r < reps; ++r) {
+        uint32 sum = 0;
+        for (const char *str = begin; str < end;) {
+          sum += utf8_decode(&str, end);
+        }
+        bench_sink += sum;
+      }
+    });
+    printf("%s: bulk %.2f GB/s, utf8_decode loop %.2f GB/s\n", text == &ascii ? "ascii" : "cyrillic", text->size() / bulk, text->size() / scalar);
+    delete_array(codepoints);
+  }
+}
+
+// every index runs once per job, for jobs smaller than the pool and empty ones too, and the pool shuts down with
+// its workers idle
+void test_worker_pool() {
+  struct Job {
+    std::vector<std::atomic<uint32>> runs;
+    Job(uint32 count) : runs(count) {}
+  };
+  auto run_job = [](WorkerPool *pool, uint32 count) {
+    Job job(count);
+    parallel_for(pool, count, [](void *data, uint32 index) {
+      ((Job *)data)->runs[index] += 1;
+    }, &job);
+    for (std::atomic<uint32> &runs : job.runs) {
+      CHECK(runs == 1);
+    }
+  };
+  for (uint32 num_threads : {1u, 3u, 0u}) { // 0 is one less than the cores
+    WorkerPool pool;
+    init_worker_pool(&pool, num_threads);
+    CHECK(num_threads == 0 || pool.num_threads == num_threads);
+    for (int round = 0; round < 20; ++round) {
+      for (uint32 count : {0u, 1u, 2u, 3u, 4u, 7u, 100u, 10007u}) {
+        run_job(&pool, count);
+      }
+    }
+    delete_worker_pool(&pool);
+    CHECK(pool.num_threads == 0);
+    run_job(&pool, 50); // a deleted pool has no workers left and runs jobs on the calling thread
+  }
+  run_job(nullptr, 50);
+}
+
+#define TEST_NUM_LABELS 60 // a settings screen
+
+void make_label_texts(char (*texts)[64]) {
+  const char *names[] = {"Settings", "Wi-Fi", "Bluetooth", "Display & brightness", "Notifications", "Sound", "Battery", "Storage", "About this phone", "Office files"};
+  for (int i = 0; i < TEST_NUM_LABELS; ++i) {
+    snprintf(texts[i], 64, "%s %d: enabled, last synced 5 minutes ago", names[i % ARRAY_LEN(names)], i);
+  }
+}
+
+// labels lay out like layout_text does, and only again when their text, style or the atlas changed
+void test_text_label() {
+  Program *program = new_text_program(32);
+  uint32 font = program->on_screen_text.layout.font;
+  char texts[TEST_NUM_LABELS][64];
+  make_label_texts(texts);
+  TextLabel labels[TEST_NUM_LABELS] = {};
+  TextLayout layout = {};
+  layout.font = font;
+  layout.max_width = 600;
+  layout.rgba = 0xffffffff;
+  for (int i = 0; i < TEST_NUM_LABELS; ++i) {
+    set_text_label(&program->fonts, &labels[i], texts[i], font, 600, 0xffffffff);
+    CHECK(layout_text(&program->fonts, &layout, texts[i], strlen(texts[i])));
+    CHECK(array_size(layout.instances) == array_size(labels[i].layout.instances));
+    CHECK(!memcmp(layout.instances, labels[i].layout.instances, array_size(layout.instances) * sizeof(GlyphInstance)));
+  }
+  delete_text_layout(&layout);
+  GlyphInstance *instances = labels[0].layout.instances;
+  uint64 key = labels[0].key;
+  set_text_label(&program->fonts, &labels[0], texts[0], font, 600, 0xffffffff);
+  CHECK(labels[0].layout.instances == instances && labels[0].key == key);
+  set_text_label(&program->fonts, &labels[0], texts[0], font, 600, 0xff0000ff);
+  CHECK(labels[0].key != key && labels[0].layout.instances[0].r == 0xff && labels[0].layout.instances[0].g == 0);
+  set_text_label(&program->fonts, &labels[0], texts[1], font, 600, 0xff0000ff);
+  CHECK(!strcmp(labels[0].text, texts[1]));
+  evict_font_glyphs(&program->fonts);
+  CHECK(labels[1].layout.font_atlas_generation != program->fonts.atlas_generation);
+  draw_text_label(program, use_glyphs_shader(program), &labels[1], 0, 0);
+  CHECK(labels[1].layout.font_atlas_generation == program->fonts.atlas_generation);
+  for (TextLabel &label : labels) {
+    delete_text_label(&label);
+  }
+  delete_text_program(program);
+}
+
+// cpu time per frame for a screen of static labels: laid out and uploaded every frame, against retained labels set
+// and drawn, drawn only, and the draw calls alone
+void bench_text_labels() {
+  Program *program = new_text_program(32);
+  uint32 font = program->on_screen_text.layout.font;
+  auto *shader = use_glyphs_shader(program);
+  char texts[TEST_NUM_LABELS][64];
+  make_label_texts(texts);
+  uint32 num_frames = 2000;
+  TextLayout layout = {};
+  GLuint *chunks = nullptr;
+  double scratch = bench_ns_per_op(num_frames, [&] {
+    for (uint32 frame = 0; frame < num_frames; ++frame) {
+      for (int i = 0; i < TEST_NUM_LABELS; ++i) {
+        layout.font = font;
+        layout.max_width = 600;
+        layout.rgba = 0xffffffff;
+        layout_text(&program->fonts, &layout, texts[i], strlen(texts[i]));
+        upload_glyph_instance_chunks(&chunks, layout.instances, array_size(layout.instances), 0, array_size(layout.instances));
+        draw_text_layout_lines(&program->fonts, shader, &layout, chunks, 0, array_size(layout.lines), 20, 30.0f * i);
+      }
+    }
+  });
+  TextLabel labels[TEST_NUM_LABELS] = {};
+  double set_and_draw = bench_ns_per_op(num_frames, [&] {
+    for (uint32 frame = 0; frame < num_frames; ++frame) {
+      for (int i = 0; i < TEST_NUM_LABELS; ++i) {
+        set_text_label(&program->fonts, &labels[i], texts[i], font, 600, 0xffffffff);
+        draw_text_label(program, shader, &labels[i], 20, 30.0f * i);
+      }
+    }
+  });
+  double draw = bench_ns_per_op(num_frames, [&] {
+    for (uint32 frame = 0; frame < num_frames; ++frame) {
+      for (int i = 0; i < TEST_NUM_LABELS; ++i) {
+        draw_text_label(program, shader, &labels[i], 20, 30.0f * i);
+      }
+    }
+  });
+  double draw_calls = bench_ns_per_op(num_frames, [&] {
+    for (uint32 frame = 0; frame < num_frames; ++frame) {
+      for (int i = 0; i < TEST_NUM_LABELS; ++i) {
+        TextLayout *label_layout = &labels[i].layout;
+        draw_text_layout_lines(&program->fonts, shader, label_layout, labels[i].gl_instance_chunks, 0, array_size(label_layout->lines), 20, 30.0f * i);
+      }
+    }
+  });
+  printf("%d labels a frame, us: from scratch %.1f, set and draw %.1f, draw %.1f, draw calls alone %.1f\n", TEST_NUM_LABELS,
+         scratch / 1e3, set_and_draw / 1e3, draw / 1e3, draw_calls / 1e3);
+  for (TextLabel &label : labels) {
+    delete_text_label(&label);
+  }
+  delete_text_layout(&layout);
+  delete_array(chunks);
+  delete_text_program(program);
+}
+
+std::atomic<int> pool_backing_mallocs(0);
+
+void *pool_counting_malloc(size_t size) {
+  pool_backing_mallocs += 1;
+  return malloc(size);
+}
+
+// installs the pool for the rest of the process, so it runs after every other test
+void test_pool_allocator() {
+  lyc_malloc = pool_counting_malloc; // becomes the pool's backing malloc
+  install_pool_allocator();
+  install_pool_allocator();
+  CHECK(lyc_malloc == pool_hook_malloc && pool_backing_allocator.malloc == pool_counting_malloc);
+  for (size_t n : {1, 15, 16, 17, 100, 2048, 2049, 100000}) {
+    void *ptr = MALLOC(byte, n);
+    CHECK((uintptr_t)ptr % 16 == 0);
+    ptr = REALLOC(ptr, byte, n * 3);
+    CHECK((uintptr_t)ptr % 16 == 0);
+    FREE(ptr);
+  }
+  CHECK(!lyc_calloc(SIZE_MAX / 2, 4));
+  int *zeros = CALLOC(int, 1000);
+  CHECK(zeros && std::all_of(zeros, zeros + 1000, [](int i) { return i == 0; }));
+  FREE(zeros);
+
+  std::mt19937 rng(5);
+  std::vector<std::pair<byte *, size_t>> live;
+  auto check_fill = [](const byte *ptr, size_t n, size_t fill) {
+    for (size_t i = 0; i < n; ++i) {
+      CHECK(ptr[i] == (byte)fill);
+    }
+  };
+  for (int i = 0; i < 200000; ++i) {
+    uint32 op = rng() % 4;
+    if (op < 2 || live.empty()) {
+      size_t n = rng() % (op ? 5000 : 300);
+      byte *ptr = MALLOC(byte, n);
+      memset(ptr, (int)(n & 0xff), n);
+      live.push_back({ptr, n});
+    } else if (op == 2) {
+      size_t j = rng() % live.size();
+      check_fill(live[j].first, live[j].second, live[j].second);
+      FREE(live[j].first);
+      live[j] = live.back();
+      live.pop_back();
+    } else {
+      size_t j = rng() % live.size();
+      size_t n = rng() % 6000;
+      byte *ptr = REALLOC(live[j].first, byte, n);
+      check_fill(ptr, std::min(n, live[j].second), live[j].second);
+      memset(ptr, (int)(n & 0xff), n);
+      live[j] = {ptr, n};
+    }
+  }
+  for (auto &l : live) {
+    FREE(l.first);
+  }
+
+  // worker threads allocate, the main thread frees, and short lived threads keep handing caches back
+  for (int round = 0; round < 50; ++round) {
+    std::vector<char *> strs[4];
+    std::thread threads[4];
+    for (int t = 0; t < 4; ++t) {
+      threads[t] = std::thread([&strs, t] {
+        for (int i = 0; i < 2000; ++i) {
+          char *str = nullptr;
+          str_cat_c(&str, "resolver record");
+          strs[t].push_back(str);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    for (auto &v : strs) {
+      for (char *str : v) {
+        CHECK(!strcmp(str, "resolver record"));
+        delete_str(str);
+      }
+    }
+  }
+
+  int backing_mallocs = pool_backing_mallocs;
+  for (int i = 0; i < 100000; ++i) {
+    char *str = str_dup_c("hello");
+    str_cat_c(&str, " world");
+    delete_str(str);
+  }
+  CHECK(pool_backing_mallocs == backing_mallocs); // small churn stays on the free lists
+}
+
+// small string churn through libc, then through the pool. installs the pool, so it runs last
+void bench_pool_allocator() {
+  uint32 n = 1000000;
+  auto churn = [n] {
+    for (uint32 i = 0; i < n; ++i) {
+      char *str = str_dup_c("hello");
+      str_cat_c(&str, " world");
+      bench_sink += str_len(str);
+      delete_str(str);
+    }
+  };
+  double libc = bench_ns_per_op(n, churn);
+  install_pool_allocator();
+  double pool = bench_ns_per_op(n, churn);
+  printf("dup + cat + delete  libc %.1f ns  pool %.1f ns\n", libc, pool);
+}
+
+struct HostTest {
+  const char *name;
+  void (*func)();
+};
+
+static const HostTest host_tests[] = {
+  {"str_ops", test_str_ops},
+  {"array_ops", test_array_ops},
+  {"array_push_own_item", test_array_push_own_item},
+  {"container_growth", test_container_growth},
+  {"hash_map", test_hash_map},
+  {"arena", test_arena},
+  {"font_atlas_height", test_font_atlas_height},
+  {"text_layout", test_text_layout},
+  {"text_relayout", test_text_relayout},
+  {"on_screen_text_scroll", test_on_screen_text_scroll},
+  {"shape_combining_marks", test_shape_combining_marks},
+  {"shape_text_run", test_shape_text_run},
+  {"expand_glyph_instances", test_expand_glyph_instances},
+  {"utf8_decode", test_utf8_decode},
+  {"text_label", test_text_label},
+  {"worker_pool", test_worker_pool},
+  {"pool_allocator", test_pool_allocator},
+};
+
+static const HostTest host_benches[] = {
+  {"containers", bench_containers},
+  {"container_growth", bench_container_growth},
+  {"hash_map", bench_hash_map},
+  {"text_layout", bench_text_layout},
+  {"utf8_decode", bench_utf8_decode},
+  {"text_labels", bench_text_labels},
+  {"pool_allocator", bench_pool_allocator},
+};
+
+int main(int argc, char **argv) {
+  bool bench = argc > 1 && !strcmp(argv[1], "bench");
+  const char *filter = argc > (bench ? 2 : 1) ? argv[bench ? 2 : 1] : "";
+  const HostTest *first = bench ? host_benches : host_tests;
+  uint32 count = bench ? ARRAY_LEN(host_benches) : ARRAY_LEN(host_tests);
+  for (const HostTest *t = first; t < first + count; ++t) {
+    if (strstr(t->name, filter)) {
+      printf("%s\n", t->name);
+      t->func();
+    }
+  }
+  printf("done\n");
+  return 0;
+}